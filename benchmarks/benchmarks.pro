@@ -0,0 +1,17 @@
+# Highlighting benchmarks. Run with the usual QTest options, e.g.
+#   highlightbenchmark -csv              machine-readable results on stdout
+#   highlightbenchmark -o result.xml,xml
+# Documents larger than BENCHMARK_MAX_LINES lines (default 1000000) are
+# skipped, so the 10M-line rows have to be enabled explicitly.
+
+TARGET = highlightbenchmark
+
+QT += testlib
+
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../editor.pri)
+
+SOURCES += \
+        highlightbenchmark.cpp
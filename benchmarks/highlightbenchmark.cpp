@@ -0,0 +1,283 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include "notepad.h"
+#include "language.h"
+
+// 高亮的基准测试：在生成的 C 和 G 代码文档上测量全部高亮一遍，以及在开头、中间、末尾输入时的耗时。
+// 每一项分两种测量：只算界面线程中同步完成的部分（initialHighlight、edit），
+// 以及按编辑器实际的方式，只有一屏可见、其余在空闲时由工作线程分析，直到全部高亮完（idleHighlight、editSettled）。
+// 耗时（毫秒）作为 QTest 的基准结果输出，可以用 -csv、-xml 等格式；
+// 设置了 HIGHLIGHT_BENCHMARK_CSV 时，另外把每一项的块数、耗时和每秒块数追加到该文件
+class HighlightBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void initialHighlight_data();
+    void initialHighlight();
+    void idleHighlight_data();
+    void idleHighlight();
+    void edit_data();
+    void edit();
+    void editSettled_data();
+    void editSettled();
+
+private:
+    static QString generate(const QString &language, int lines);
+    static void addDocumentColumns();
+    void skipLargeDocument(int lines) const;
+    void record(int blocks, qint64 nsecs) const;
+    static void waitUntilHighlighted(MySyntaxHighlighterEditor *highlighter);
+
+    int maxLines; //超过这个行数的文档跳过
+};
+
+static const int EditViewLines = 50; //输入时可见的行数
+
+static const struct {
+    const char *tag;
+    int lines;
+} DocumentSizes[] = {
+    { "10K", 10000 }, { "1M", 1000000 }, { "10M", 10000000 },
+};
+
+static const char *const Languages[] = { "C", "GCode" };
+
+void HighlightBenchmark::initTestCase()
+{
+    bool ok = false;
+    maxLines = qEnvironmentVariableIntValue("BENCHMARK_MAX_LINES", &ok);
+    if (!ok) {
+        maxLines = 1000000;
+    }
+}
+
+// C 的文档含有跨行的块注释和字符串，G 代码的文档是典型的 CAM 输出
+QString HighlightBenchmark::generate(const QString &language, int lines)
+{
+    static const char *const CLines[] = {
+        "/* block comment",
+        " * spanning lines */",
+        "#include <stdio.h>",
+        "static int counter = 0; // line comment",
+        "int main(int argc, char *argv[])",
+        "{",
+        "    printf(\"%d\\n\", argc / 2);",
+        "    return 0;",
+        "}",
+    };
+
+    QString text;
+    text.reserve(lines * 32);
+    for (int i = 0; i < lines; ++i) {
+        if (i) {
+            text += QLatin1Char('\n');
+        }
+        if (language == QLatin1String("C")) {
+            text += QLatin1String(CLines[i % (sizeof(CLines) / sizeof(CLines[0]))]);
+        } else if (i % 50 == 0) {
+            text += QString("N%1 G00 Z5.000 (retract) ; pass %2").arg(i).arg(i / 50);
+        } else if (i % 50 == 1) {
+            text += QString("N%1 M03 S12000 T%2").arg(i).arg(i / 50 % 8 + 1);
+        } else {
+            text += QString("N%1 G01 X%2 Y%3 F1200").arg(i).arg(i % 997 * 0.125, 0, 'f', 3)
+                                                          .arg(-(i % 331) * 0.5, 0, 'f', 3);
+        }
+    }
+    return text;
+}
+
+void HighlightBenchmark::addDocumentColumns()
+{
+    QTest::addColumn<QString>("language");
+    QTest::addColumn<int>("lines");
+}
+
+void HighlightBenchmark::skipLargeDocument(int lines) const
+{
+    if (lines > maxLines) {
+        QSKIP("larger than BENCHMARK_MAX_LINES");
+    }
+}
+
+void HighlightBenchmark::record(int blocks, qint64 nsecs) const
+{
+    double msecs = nsecs / 1e6;
+    QTest::setBenchmarkResult(msecs, QTest::WalltimeMilliseconds);
+
+    QString fileName = QString::fromLocal8Bit(qgetenv("HIGHLIGHT_BENCHMARK_CSV"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        double rate = nsecs > 0 ? blocks * 1e9 / nsecs : 0;
+        file.write(QString("%1,%2,%3,%4,%5\n").arg(QTest::currentTestFunction())
+                   .arg(QTest::currentDataTag()).arg(blocks).arg(msecs, 0, 'f', 3)
+                   .arg(rate, 0, 'f', 0).toUtf8());
+    }
+}
+
+// 运行事件循环，直到空闲时的高亮（定时器和工作线程）把所有块都高亮完；
+// 其中包括编辑器有意留出的间隔（修改后的停顿、两批之间的间隔），与实际使用时相同
+void HighlightBenchmark::waitUntilHighlighted(MySyntaxHighlighterEditor *highlighter)
+{
+    while (highlighter->hasPending()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+}
+
+void HighlightBenchmark::initialHighlight_data()
+{
+    addDocumentColumns();
+    for (const char *language : Languages) {
+        for (const auto &size : DocumentSizes) {
+            QTest::newRow(QByteArray(language) + ' ' + size.tag) << QString(language) << size.lines;
+        }
+    }
+}
+
+// 设置语言后把整个文档设为可见，所有块在界面线程中高亮一遍（不经过空闲时的工作线程）
+void HighlightBenchmark::initialHighlight()
+{
+    QFETCH(QString, language);
+    QFETCH(int, lines);
+    skipLargeDocument(lines);
+
+    QTextDocument document(generate(language, lines));
+    MySyntaxHighlighterEditor *highlighter = new MySyntaxHighlighterEditor(&document);
+
+    QElapsedTimer timer;
+    timer.start();
+    highlighter->setLanguage(LanguageRegistry::language(language));
+    highlighter->setVisibleBlocks(0, document.blockCount() - 1);
+    qint64 nsecs = timer.nsecsElapsed();
+
+    record(highlighter->cacheHits() + highlighter->cacheMisses(), nsecs);
+}
+
+void HighlightBenchmark::idleHighlight_data()
+{
+    initialHighlight_data();
+}
+
+// 与打开文件时相同：只有开头一屏可见，其余的块在空闲时交给工作线程，测量到全部高亮完为止
+void HighlightBenchmark::idleHighlight()
+{
+    QFETCH(QString, language);
+    QFETCH(int, lines);
+    skipLargeDocument(lines);
+
+    QTextDocument document(generate(language, lines));
+    MySyntaxHighlighterEditor *highlighter = new MySyntaxHighlighterEditor(&document);
+
+    QElapsedTimer timer;
+    timer.start();
+    highlighter->setLanguage(LanguageRegistry::language(language));
+    highlighter->setVisibleBlocks(0, EditViewLines);
+    waitUntilHighlighted(highlighter);
+    qint64 nsecs = timer.nsecsElapsed();
+
+    record(highlighter->cacheHits() + highlighter->cacheMisses(), nsecs);
+}
+
+void HighlightBenchmark::edit_data()
+{
+    addDocumentColumns();
+    QTest::addColumn<double>("position"); //修改处在文档中的位置（比例）
+    QTest::addColumn<QString>("text"); //输入的内容
+
+    static const struct {
+        const char *tag;
+        double position;
+    } Positions[] = {
+        { "top", 0 }, { "middle", 0.5 }, { "end", 1 },
+    };
+
+    for (const char *language : Languages) {
+        for (const auto &size : DocumentSizes) {
+            for (const auto &position : Positions) {
+                QByteArray tag = QByteArray(language) + ' ' + size.tag + ' ' + position.tag;
+                QTest::newRow(tag) << QString(language) << size.lines << position.position << QString("x");
+                if (QByteArray(language) == "C") {
+                    // 开始一段块注释，之后各行的状态都变了
+                    QTest::newRow(tag + " comment") << QString(language) << size.lines
+                                                    << position.position << QString("/*");
+                }
+            }
+        }
+    }
+}
+
+// 先全部高亮一遍，再在可见范围内输入，测量这一次输入在界面线程中同步完成的高亮（只有可见范围附近）
+void HighlightBenchmark::edit()
+{
+    QFETCH(QString, language);
+    QFETCH(int, lines);
+    QFETCH(double, position);
+    QFETCH(QString, text);
+    skipLargeDocument(lines);
+
+    QTextDocument document(generate(language, lines));
+    MySyntaxHighlighterEditor *highlighter = new MySyntaxHighlighterEditor(&document);
+    highlighter->setLanguage(LanguageRegistry::language(language));
+    highlighter->setVisibleBlocks(0, document.blockCount() - 1);
+
+    int line = qMin(int(position * lines), lines - 1);
+    int first = qMax(0, line - EditViewLines / 2);
+    highlighter->setVisibleBlocks(first, first + EditViewLines);
+    highlighter->resetCacheCounters();
+
+    QTextCursor cursor(document.findBlockByNumber(line));
+    QElapsedTimer timer;
+    timer.start();
+    cursor.insertText(text);
+    qint64 nsecs = timer.nsecsElapsed();
+
+    record(highlighter->cacheHits() + highlighter->cacheMisses(), nsecs);
+}
+
+void HighlightBenchmark::editSettled_data()
+{
+    edit_data();
+}
+
+// 与 edit() 相同的输入，测量到不可见的块也在空闲时重新高亮完为止（例如输入 "/*" 后其后的所有块）
+void HighlightBenchmark::editSettled()
+{
+    QFETCH(QString, language);
+    QFETCH(int, lines);
+    QFETCH(double, position);
+    QFETCH(QString, text);
+    skipLargeDocument(lines);
+
+    QTextDocument document(generate(language, lines));
+    MySyntaxHighlighterEditor *highlighter = new MySyntaxHighlighterEditor(&document);
+    highlighter->setLanguage(LanguageRegistry::language(language));
+    highlighter->setVisibleBlocks(0, document.blockCount() - 1);
+    waitUntilHighlighted(highlighter);
+
+    int line = qMin(int(position * lines), lines - 1);
+    int first = qMax(0, line - EditViewLines / 2);
+    highlighter->setVisibleBlocks(first, first + EditViewLines);
+    highlighter->resetCacheCounters();
+
+    QTextCursor cursor(document.findBlockByNumber(line));
+    QElapsedTimer timer;
+    timer.start();
+    cursor.insertText(text);
+    waitUntilHighlighted(highlighter);
+    qint64 nsecs = timer.nsecsElapsed();
+
+    record(highlighter->cacheHits() + highlighter->cacheMisses(), nsecs);
+}
+
+QTEST_MAIN(HighlightBenchmark)
+
+#include "highlightbenchmark.moc"
@@ -0,0 +1,36 @@
+#include "builtinsyntax.h"
+
+// syntaxtables.h 中的每种语言是一段 SYNTAX_BEGIN / SYNTAX_KEYWORD / SYNTAX_END，
+// 最后是各语言的 SYNTAX_LANGUAGE 列表；这里包含两次，分别展开为关键字表和语言列表
+#define SYNTAX_BEGIN(name) static constexpr KeywordDefinition SyntaxKeywords_##name[] = {
+#define SYNTAX_KEYWORD(word, r, g, b) { word, r, g, b },
+#define SYNTAX_END(name) };
+#define SYNTAX_LANGUAGE(name)
+#include "syntaxtables.h"
+#undef SYNTAX_BEGIN
+#undef SYNTAX_KEYWORD
+#undef SYNTAX_END
+#undef SYNTAX_LANGUAGE
+
+#define SYNTAX_BEGIN(name)
+#define SYNTAX_KEYWORD(word, r, g, b)
+#define SYNTAX_END(name)
+#define SYNTAX_LANGUAGE(name) \
+    { #name, SyntaxKeywords_##name, int(sizeof(SyntaxKeywords_##name) / sizeof(KeywordDefinition)) },
+static constexpr BuiltinSyntax BuiltinSyntaxes[] = {
+#include "syntaxtables.h"
+};
+#undef SYNTAX_BEGIN
+#undef SYNTAX_KEYWORD
+#undef SYNTAX_END
+#undef SYNTAX_LANGUAGE
+
+const BuiltinSyntax *findBuiltinSyntax(const QString &name)
+{
+    for (const BuiltinSyntax &syntax : BuiltinSyntaxes) {
+        if (name == QLatin1String(syntax.name)) {
+            return &syntax;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef BUILTINSYNTAX_H
+#define BUILTINSYNTAX_H
+
+#include <QString>
+
+// 编译进程序的语法定义，由 SynatxHight/*.txt 在 qmake 运行时生成（见 syntax.pri）
+struct KeywordDefinition {
+    const char *word;
+    int r, g, b;
+};
+
+struct BuiltinSyntax {
+    const char *name;   //定义文件名（不含扩展名）
+    const KeywordDefinition *keywords;  //按关键字排序
+    int count;
+};
+
+const BuiltinSyntax *findBuiltinSyntax(const QString &name); //没有时返回 0
+
+#endif // BUILTINSYNTAX_H
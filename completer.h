@@ -5,6 +5,7 @@
 
 class MyCompleter : public QCompleter {
 public:
+    MyCompleter(QObject *parent = nullptr) : QCompleter(parent) {}
     MyCompleter(const QStringList& completions, QObject *parent = nullptr) : QCompleter(completions, parent) {}
 
 protected:
@@ -18,6 +18,7 @@ Config::Config()
     recentFiles = settings.value("recentFiles").toStringList();
     maxRecentFiles = settings.value("maxRecentFiles", 10).toInt();
     showReadme = settings.value("showReadme", false).toBool();
+    fileStates = settings.value("fileStates").toMap();
     mainWindowsGeometry = settings.value("mainWindowGeometry").toByteArray();
     mainWindowState = settings.value("mainWindoState").toByteArray();
     settings.endGroup();  // General
@@ -34,6 +35,7 @@ Config::Config()
     indentSize = settings.value("indentSize", 4).toInt();
     tabSize = settings.value("tabSize", 4).toInt();
     whitespaces = settings.value("whitespaces").toBool();
+    largeFileSize = settings.value("largeFileSize", 256).toInt();
     settings.endGroup(); // Editor
 
     settings.beginGroup("Search&Replace");
@@ -42,6 +44,8 @@ Config::Config()
     maxHistory = settings.value("maxHistory").toInt();
     matchCase = settings.value("matchCase").toBool();
     regExp = settings.value("regExp").toBool();
+    findDirectory = settings.value("findDirectory").toString();
+    findFilters = settings.value("findFilters").toString();
     settings.endGroup(); // Search&Replace
 }
 
@@ -57,6 +61,7 @@ Config::~Config()
     settings.setValue("recentFiles", recentFiles);
     settings.setValue("maxRecentFile", maxRecentFiles);
     settings.setValue("showReadme", showReadme);
+    settings.setValue("fileStates", fileStates);
     settings.setValue("mainWindowGeometry", mainWindowsGeometry);
     settings.setValue("mainWindoState", mainWindowState);
     settings.endGroup(); // End General
@@ -73,6 +78,7 @@ Config::~Config()
     settings.setValue("indentSize", indentSize);
     settings.setValue("tabSize", tabSize);
     settings.setValue("whitespaces", whitespaces);
+    settings.setValue("largeFileSize", largeFileSize);
     settings.endGroup(); // End Editor
 
     settings.beginGroup("Search&Replace");
@@ -83,6 +89,8 @@ Config::~Config()
     settings.setValue("replaceHistory", replaceHistory);
     settings.setValue("matchCase", matchCase);
     settings.setValue("regExp", regExp);
+    settings.setValue("findDirectory", findDirectory);
+    settings.setValue("findFilters", findFilters);
     settings.endGroup(); // End Search&Replace
 }
 
@@ -5,6 +5,7 @@
 #include <QString>
 #include <QByteArray>
 #include <QSettings>
+#include <QVariantMap>
 
 struct Config: public QObject
 {
@@ -38,6 +39,7 @@ public:
     int maxRecentFiles; //最大文件数（最近的文档）
     QStringList recentFiles; //最近的文档
     bool showReadme; //是否显示readme文件
+    QVariantMap fileStates; //各文件的光标和滚动位置（恢复上次打开的文件时使用）
 
     //Editor
     QString fontFamily; //字体设置
@@ -54,6 +56,7 @@ public:
     int tabSize; //Tab所占字符大小
 
     bool whitespaces; //是否使用空格代替Tab
+    int largeFileSize; //超过该大小（MB）的文件以只读方式分段显示（不超过 256 MB 的上限）
 
     //Search
     int maxHistory; //查找和替换的最大记录数
@@ -62,6 +65,8 @@ public:
 
     bool matchCase; //是否匹配大小写
     bool regExp; //是否采用正则表达式
+    QString findDirectory; //在文件中查找的目录（为空时查找打开的标签页）
+    QString findFilters; //在文件中查找的文件名模式
 };
 
 #endif//CONFIG_H
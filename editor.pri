@@ -0,0 +1,75 @@
+# Everything except main.cpp, shared by the editor (editor.pro) and the
+# benchmarks (benchmarks/benchmarks.pro).
+
+QT += gui core printsupport concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11
+
+# The following define makes your compiler emit warnings if you use
+# any Qt feature that has been marked deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# You can also make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        $$PWD/builtinsyntax.cpp \
+        $$PWD/completer.cpp \
+        $$PWD/config.cpp \
+        $$PWD/encoding.cpp \
+        $$PWD/fileloader.cpp \
+        $$PWD/keywordtable.cpp \
+        $$PWD/filesaver.cpp \
+        $$PWD/findall.cpp \
+        $$PWD/findinfiles.cpp \
+        $$PWD/findinfilespanel.cpp \
+        $$PWD/language.cpp \
+        $$PWD/largefileview.cpp \
+        $$PWD/literalmatcher.cpp \
+        $$PWD/lexer.cpp \
+        $$PWD/lineindex.cpp \
+        $$PWD/mainwindow.cpp \
+        $$PWD/mappedfile.cpp \
+        $$PWD/notepad.cpp \
+        $$PWD/patterncache.cpp \
+        $$PWD/piecetable.cpp \
+        $$PWD/searchdialog.cpp
+
+RESOURCES += \
+    $$PWD/resources.qrc
+
+FORMS += \
+    $$PWD/searchdialog.ui
+
+HEADERS += \
+    $$PWD/builtinsyntax.h \
+    $$PWD/completer.h \
+    $$PWD/config.h \
+    $$PWD/encoding.h \
+    $$PWD/fileloader.h \
+    $$PWD/keywordtable.h \
+    $$PWD/filesaver.h \
+    $$PWD/findall.h \
+    $$PWD/findinfiles.h \
+    $$PWD/findinfilespanel.h \
+    $$PWD/language.h \
+    $$PWD/largefileview.h \
+    $$PWD/lexer.h \
+    $$PWD/literalmatcher.h \
+    $$PWD/lineindex.h \
+    $$PWD/mainwindow.h \
+    $$PWD/mappedfile.h \
+    $$PWD/notepad.h \
+    $$PWD/patterncache.h \
+    $$PWD/piecetable.h \
+    $$PWD/searchdialog.h
+
+include($$PWD/syntax.pri)
@@ -0,0 +1,16 @@
+TARGET = Q-Text-Editor
+VERSION = 0.1.0.0
+
+QMAKE_TARGET_COPYRIGHT = "Copyright(C) 2023 Ray Lee, All Rights Reserved."
+
+RC_ICONS = images/notepad.ico
+
+include(editor.pri)
+
+SOURCES += \
+        main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,248 @@
+#include <QTextCodec>
+
+#include <string.h>
+
+#include "encoding.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENCODING_SSE2
+#endif
+
+static const qint64 HeadSample = 1024 * 1024;   // 只检查样本时检查开头的字节数
+static const qint64 TailSample = 64 * 1024;     // 以及结尾的字节数
+static const qint64 Utf16Sample = 64 * 1024;    // 判断是否为没有字节序标记的 UTF-16 时检查的字节数
+
+FileEncoding::FileEncoding()
+    : textCodec(QTextCodec::codecForMib(106)), bomSize(0), unit(1), bigEndian(false)
+{
+}
+
+FileEncoding::FileEncoding(const char *name, int bomSize)
+    : textCodec(QTextCodec::codecForName(name)), bomSize(bomSize), unit(1), bigEndian(false)
+{
+    int mib = textCodec->mibEnum();
+    if (mib == 1013 || mib == 1014) {   // UTF-16BE、UTF-16LE
+        unit = 2;
+        bigEndian = mib == 1013;
+    }
+}
+
+// 先看字节序标记和没有标记的 UTF-16，再检查内容：合法的 UTF-8（包括纯 ASCII）按 UTF-8，
+// 否则合法的 GB18030 按 GB18030，都不是时按 Latin-1（任何字节序列都能解码）。
+// whole 为假时只检查开头和结尾，打开文件时在界面线程中这样检测，
+// 其余内容由 FileLoader 在工作线程解码时用 accepts() 逐段检查，不符合时再检查全部内容
+FileEncoding FileEncoding::detect(const char *data, qint64 size, bool whole)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+        return FileEncoding("UTF-8", 3);
+    }
+    if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE) {
+        return FileEncoding("UTF-16LE", 2);
+    }
+    if (size >= 2 && p[0] == 0xFE && p[1] == 0xFF) {
+        return FileEncoding("UTF-16BE", 2);
+    }
+
+    int order = utf16Order(data, qMin(size, Utf16Sample));
+    if (order) {
+        return FileEncoding(order == 1 ? "UTF-16LE" : "UTF-16BE", 0);
+    }
+
+    if (whole) {
+        if (isUtf8(data, size, false)) {
+            return FileEncoding();
+        }
+        if (isGb18030(data, size, false)) {
+            return FileEncoding("GB18030", 0);
+        }
+        return FileEncoding("ISO-8859-1", 0);
+    }
+
+    // 结尾的样本从一个完整字符开始：跳过开头的 UTF-8 后续字节
+    qint64 head = qMin(size, HeadSample);
+    qint64 tail = qMin(size - head, TailSample);
+    qint64 tailStart = size - tail;
+    for (int i = 0; i < 3 && tail > 0 && (p[tailStart] & 0xC0) == 0x80; ++i) {
+        ++tailStart;
+        --tail;
+    }
+
+    if (isUtf8(data, head, head < size)
+            && (tail == 0 || isUtf8(data + tailStart, tail, false))) {
+        return FileEncoding();
+    }
+    // GB18030 的尾字节可能落在 ASCII 范围内，无法从中间开始检查，只看开头
+    if (isGb18030(data, head, head < size)) {
+        return FileEncoding("GB18030", 0);
+    }
+    return FileEncoding("ISO-8859-1", 0);
+}
+
+// 文本中 ASCII 字符占多数，UTF-16 的高字节大多为 0：一侧的 0 字节超过三成而另一侧几乎没有时
+// 认为是 UTF-16（0 在 UTF-8 和 GB18030 中只会出现在二进制文件里）
+int FileEncoding::utf16Order(const char *data, qint64 size)
+{
+    qint64 units = size / 2;
+    if (units < 2) {
+        return 0;
+    }
+
+    qint64 zeros[2] = { 0, 0 };
+    for (qint64 i = 0; i < units * 2; ++i) {
+        zeros[i & 1] += data[i] == 0;
+    }
+    if (zeros[1] * 10 >= units * 3 && zeros[0] * 20 < units) {
+        return 1;   // 小端：高字节在奇数位置
+    }
+    if (zeros[0] * 10 >= units * 3 && zeros[1] * 20 < units) {
+        return 2;
+    }
+    return 0;
+}
+
+// Latin-1 和 UTF-16 能解码任何内容，不必检查
+bool FileEncoding::accepts(const char *data, qint64 size) const
+{
+    switch (textCodec->mibEnum()) {
+        case 106:
+            return isUtf8(data, size, false);
+        case 114:
+            return isGb18030(data, size, false);
+        default:
+            return true;
+    }
+}
+
+QByteArray FileEncoding::name() const
+{
+    return textCodec->name();
+}
+
+QByteArray FileEncoding::bom() const
+{
+    if (!bomSize) {
+        return QByteArray();
+    }
+    if (unit == 2) {
+        return bigEndian ? QByteArray("\xFE\xFF", 2) : QByteArray("\xFF\xFE", 2);
+    }
+    return QByteArray("\xEF\xBB\xBF", 3);
+}
+
+// 开头连续的 ASCII 字节数：每次检查 16 个字节（SSE2）或 8 个字节
+qint64 FileEncoding::asciiLength(const char *data, qint64 size)
+{
+    qint64 i = 0;
+
+#ifdef ENCODING_SSE2
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        int mask = _mm_movemask_epi8(chunk);    // 每个字节的最高位
+        if (mask) {
+            return i + qCountTrailingZeroBits(uint(mask));
+        }
+    }
+#else
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        memcpy(&word, data + i, 8);
+        if (word & Q_UINT64_C(0x8080808080808080)) {
+            break;
+        }
+    }
+#endif
+
+    while (i < size && uchar(data[i]) < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+// 检查是否为合法的 UTF-8：ASCII 部分整段跳过，只逐字节检查多字节序列；
+// partial 为真时末尾被截断的序列不算错误
+bool FileEncoding::isUtf8(const char *data, qint64 size, bool partial)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    qint64 i = 0;
+
+    while (i < size) {
+        i += asciiLength(data + i, size - i);
+        if (i >= size) {
+            break;
+        }
+
+        uchar c = p[i];
+        int n;
+        uchar min = 0x80, max = 0xBF;   // 第二个字节的范围
+        if (c >= 0xC2 && c <= 0xDF) {
+            n = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 3;
+            if (c == 0xE0) {
+                min = 0xA0;     // 超长编码
+            } else if (c == 0xED) {
+                max = 0x9F;     // 代理区
+            }
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 4;
+            if (c == 0xF0) {
+                min = 0x90;
+            } else if (c == 0xF4) {
+                max = 0x8F;     // 超出 U+10FFFF
+            }
+        } else {
+            return false;
+        }
+
+        for (int k = 1; k < n; ++k) {
+            if (i + k >= size) {
+                return partial;
+            }
+            uchar b = p[i + k];
+            if (k == 1 ? (b < min || b > max) : (b & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += n;
+    }
+    return true;
+}
+
+// 检查是否为合法的 GB18030：双字节为 81-FE 40-7E/80-FE，四字节为 81-FE 30-39 81-FE 30-39
+bool FileEncoding::isGb18030(const char *data, qint64 size, bool partial)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    qint64 i = 0;
+
+    while (i < size) {
+        i += asciiLength(data + i, size - i);
+        if (i >= size) {
+            break;
+        }
+
+        if (p[i] < 0x81 || p[i] > 0xFE) {
+            return false;
+        }
+        if (i + 1 >= size) {
+            return partial;
+        }
+
+        uchar b = p[i + 1];
+        if (b >= 0x30 && b <= 0x39) {
+            if (i + 3 >= size) {
+                return partial;
+            }
+            if (p[i + 2] < 0x81 || p[i + 2] > 0xFE || p[i + 3] < 0x30 || p[i + 3] > 0x39) {
+                return false;
+            }
+            i += 4;
+        } else if ((b >= 0x40 && b <= 0x7E) || (b >= 0x80 && b <= 0xFE)) {
+            i += 2;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
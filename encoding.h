@@ -0,0 +1,40 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <QByteArray>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QTextCodec)
+QT_END_NAMESPACE
+
+// 文件的编码：打开时根据内容检测，保存时按同样的编码（包括字节序标记）写回
+class FileEncoding
+{
+public:
+    FileEncoding(); //默认为不带字节序标记的 UTF-8
+    static FileEncoding detect(const char *data, qint64 size, bool whole = true); //检测编码（whole 为假时只检查开头和结尾）
+
+    QTextCodec *codec() const { return textCodec; }
+    QByteArray name() const;
+    QByteArray bom() const;     //字节序标记（没有时为空）
+    int bomLength() const { return bomSize; }
+    int unitSize() const { return unit; }   //编码单元的字节数（UTF-16 为 2）
+    bool isBigEndian() const { return bigEndian; }
+    bool isAsciiCompatible() const { return unit == 1; }   //ASCII 字符按原样编码
+    bool accepts(const char *data, qint64 size) const; //data 是否为这种编码的合法内容（按它解码后能原样写回）
+
+    static qint64 asciiLength(const char *data, qint64 size);  //开头连续的 ASCII 字节数
+    static bool isUtf8(const char *data, qint64 size, bool partial);   //是否为合法的 UTF-8
+    static bool isGb18030(const char *data, qint64 size, bool partial); //是否为合法的 GB18030
+    static int utf16Order(const char *data, qint64 size);  //没有字节序标记的 UTF-16：1 为小端，2 为大端，不像时为 0
+
+private:
+    FileEncoding(const char *name, int bomSize);
+
+    QTextCodec *textCodec;
+    int bomSize;
+    int unit;
+    bool bigEndian;
+};
+
+#endif // ENCODING_H
@@ -0,0 +1,274 @@
+#include <QTextCodec>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "fileloader.h"
+
+static const int MaxPendingChunks = 4;  // 界面线程来不及追加时，工作线程最多领先的段数
+static const int MaxConcurrentLoads = 8;    // 同时解码的文件数
+
+// 每个文件的解码是一个长任务，领先太多时还要等界面线程取走，同时打开多个文件时会占满线程。
+// 载入使用单独的线程池，不占用全局线程池中高亮、全部查找、换行索引等任务的线程
+Q_GLOBAL_STATIC(QThreadPool, globalLoaderPool)
+
+// 线程数只在第一次使用时设定（局部静态变量的初始化是线程安全的）
+static QThreadPool *loaderPool()
+{
+    static const bool configured = (globalLoaderPool()->setMaxThreadCount(MaxConcurrentLoads), true);
+    Q_UNUSED(configured);
+    return globalLoaderPool();
+}
+
+FileLoader::FileLoader(const QString &fileName, QObject *parent)
+    : QObject(parent), path(fileName), bytes(0),
+      length(0), offset(0), decoder(0), lineStart(true), verify(false), checked(0),
+      wrongEncoding(false), chunkSize(0),
+      stopped(false), finished(false)
+{
+}
+
+FileLoader::~FileLoader()
+{
+    close();
+}
+
+// 打开文件并建立内存映射。在界面线程中只检查开头和结尾的样本，不必读遍整个文件；
+// 样本按 UTF-8 或 GB18030 检测时，verify 为真则在解码过程中检查其余内容（见 checkEncoding()）
+bool FileLoader::open(bool verify)
+{
+    if (!map()) {
+        return false;
+    }
+
+    // 字节序标记不交给解码器，UTF-16 的解码器会把它当作普通字符
+    fileEncoding = FileEncoding::detect(bytes, length, false);
+    startAt(fileEncoding.bomLength());
+    this->verify = verify && fileEncoding.bomLength() == 0;
+    return true;
+}
+
+// 从 from 处继续读取，不再检测编码，只需解码 from 之后的内容
+bool FileLoader::open(qint64 from, const FileEncoding &encoding)
+{
+    if (!map()) {
+        return false;
+    }
+    if (length < from) {
+        close();
+        return false;
+    }
+
+    fileEncoding = encoding;
+    startAt(from);
+    return true;
+}
+
+bool FileLoader::map()
+{
+    mapping = QSharedPointer<MappedFile>(new MappedFile(path));
+    if (!mapping->isValid()) {
+        mapping.clear();
+        return false;
+    }
+
+    bytes = mapping->data();
+    length = mapping->size();
+    return true;
+}
+
+void FileLoader::startAt(qint64 from)
+{
+    offset = checked = from;
+    verify = wrongEncoding = false;
+    delete decoder;
+    decoder = fileEncoding.codec()->makeDecoder();
+    lineStart = true;
+}
+
+// 解除映射（文档或快照仍在使用时映射会保留到它们释放为止）
+void FileLoader::close()
+{
+    stop();
+
+    delete decoder;
+    decoder = 0;
+
+    mapping.clear();
+    bytes = 0;
+    length = offset = 0;
+}
+
+// 解码下一段文本，尽量在换行处截断，使每一段都由完整的行组成
+// wholeLines 时只读到最后一个换行为止，末尾正在写入的行留到下次再读
+QString FileLoader::read(qint64 maxSize, bool wholeLines)
+{
+    if (!decoder || atEnd()) {
+        return QString();
+    }
+
+    qint64 end = chunkEnd(qMin(length, offset + maxSize), wholeLines);
+    if (end == offset) {
+        return QString();
+    }
+    const char *data = bytes + offset;
+    int size = int(end - offset);
+
+    QString text;
+    if (lineStart && fileEncoding.isAsciiCompatible()) {
+        // 文件大多是 ASCII：开头的 ASCII 部分直接展开为 UTF-16，其余部分交给解码器
+        int ascii = int(FileEncoding::asciiLength(data, size));
+        text = QString::fromLatin1(data, ascii);
+        if (ascii < size) {
+            text += decoder->toUnicode(data + ascii, size - ascii);
+        }
+    } else {
+        text = decoder->toUnicode(data, size);
+    }
+
+    lineStart = end == length || bytes[end - 1] == '\n';
+    offset = end;
+    if (verify) {
+        checkEncoding(end);
+    }
+    return text;
+}
+
+// 打开时只检查了样本，其余内容在解码时检查（主要在工作线程中）。每次检查到最后一个换行为止：
+// 换行不会出现在 UTF-8 和 GB18030 的多字节字符中间，不完整的行留到下一次。
+// 不符合时在这里检查全部内容重新检测编码，之后不再解码，由使用者按 detectedEncoding() 重新载入
+void FileLoader::checkEncoding(qint64 end)
+{
+    if (end < length) {
+        QByteArray chunk = QByteArray::fromRawData(bytes + checked, int(end - checked));
+        int newline = chunk.lastIndexOf('\n');
+        if (newline == -1) {
+            return;
+        }
+        end = checked + newline + 1;
+    }
+
+    if (!fileEncoding.accepts(bytes + checked, end - checked)) {
+        redetected = FileEncoding::detect(bytes, length);
+        wrongEncoding = true;
+    }
+    checked = end;
+}
+
+// 把一段的结尾调整到最后一个换行之后；一行比一段还长时不要把 \r\n 拆开
+qint64 FileLoader::chunkEnd(qint64 end, bool wholeLines) const
+{
+    if (end >= length && !wholeLines) {
+        return length;
+    }
+
+    if (fileEncoding.unitSize() == 1) {
+        QByteArray chunk = QByteArray::fromRawData(bytes + offset, int(end - offset));
+        int newline = chunk.lastIndexOf('\n');
+        if (newline != -1) {
+            return offset + newline + 1;
+        }
+        if (wholeLines) {
+            return offset;
+        }
+        if (end - offset > 1 && bytes[end - 1] == '\r') {
+            --end;
+        }
+        return end;
+    }
+
+    // UTF-16：按编码单元查找
+    end -= (end - offset) % 2;
+    const uchar *p = reinterpret_cast<const uchar *>(bytes);
+    bool big = fileEncoding.isBigEndian();
+    auto unitAt = [p, big](qint64 i) {
+        return big ? ushort(p[i] << 8 | p[i + 1]) : ushort(p[i + 1] << 8 | p[i]);
+    };
+
+    for (qint64 i = end - 2; i >= offset; i -= 2) {
+        if (unitAt(i) == '\n') {
+            return i + 2;
+        }
+    }
+    if (wholeLines) {
+        return offset;
+    }
+
+    // 不在 \r\n 或代理对中间截断
+    ushort last = unitAt(end - 2);
+    if (end - offset > 2 && (last == '\r' || QChar::isHighSurrogate(last))) {
+        end -= 2;
+    }
+    return end;
+}
+
+// 在线程池中解码剩余内容，每解码出一段发出一次 chunkReady()
+void FileLoader::start(qint64 bytesPerChunk)
+{
+    chunkSize = bytesPerChunk;
+    stopped = false;
+    finished = false;
+    future = QtConcurrent::run(loaderPool(), this, &FileLoader::run);
+}
+
+// 停止工作线程并等待其退出
+void FileLoader::stop()
+{
+    mutex.lock();
+    stopped = true;
+    notFull.wakeAll();
+    mutex.unlock();
+
+    future.waitForFinished();
+}
+
+// 取出一段工作线程已解码的内容
+bool FileLoader::takeChunk(QString *text, qint64 *end)
+{
+    QMutexLocker locker(&mutex);
+    if (chunks.isEmpty()) {
+        return false;
+    }
+
+    Chunk chunk = chunks.dequeue();
+    notFull.wakeAll();
+    *text = chunk.text;
+    *end = chunk.end;
+    return true;
+}
+
+bool FileLoader::isFinished()
+{
+    QMutexLocker locker(&mutex);
+    return finished && chunks.isEmpty();
+}
+
+void FileLoader::run()
+{
+    forever {
+        mutex.lock();
+        while (!stopped && chunks.size() >= MaxPendingChunks) {
+            notFull.wait(&mutex);
+        }
+        bool quit = stopped;
+        mutex.unlock();
+
+        if (quit) {
+            return;
+        }
+
+        Chunk chunk;
+        chunk.text = read(chunkSize);
+        chunk.end = offset;
+
+        mutex.lock();
+        chunks.enqueue(chunk);
+        finished = atEnd();
+        quit = finished;
+        mutex.unlock();
+
+        emit chunkReady();
+        if (quit) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+#include <QSharedPointer>
+
+#include "mappedfile.h"
+#include "encoding.h"
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QTextDecoder)
+QT_END_NAMESPACE
+
+// 以内存映射方式读取文件，按检测到的编码分段解码，避免 readAll 把整个文件复制到内存
+// start() 之后由线程池中的工作线程继续解码，界面线程通过 takeChunk() 逐段取走
+class FileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileLoader(const QString &fileName, QObject *parent = 0);
+    ~FileLoader();
+
+    bool open(bool verify = true); //打开文件并建立映射，按开头和结尾的样本检测编码（verify 见 hasWrongEncoding()）
+    bool open(qint64 from, const FileEncoding &encoding); //从 from 处继续读取编码已知的文件（跟踪文件增长时使用）
+    void close();   //解除映射并关闭文件
+    QString read(qint64 maxSize, bool wholeLines = false);   //解码下一段文本（在换行处截断，wholeLines 时不读末尾不完整的行）
+
+    void start(qint64 bytesPerChunk);   //在线程池中解码剩余内容
+    void stop();    //停止工作线程并等待其退出，之后可以继续调用 read()
+    bool takeChunk(QString *text, qint64 *end); //取出一段工作线程已解码的内容
+    bool isFinished();  //工作线程已解码到末尾且内容都已取走
+
+    QString fileName() const { return path; }
+    QSharedPointer<MappedFile> mappedFile() const { return mapping; }   //文件的映射
+    FileEncoding encoding() const { return fileEncoding; } //检测到的编码
+    qint64 size() const { return length; }  //文件大小（字节）
+    qint64 pos() const { return offset; }   //已解码的字节数（工作线程运行时不可用）
+    bool atEnd() const { return offset >= length || wrongEncoding; }   //已解码到末尾，或编码检查失败
+    bool hasWrongEncoding() const { return wrongEncoding; } //解码时发现样本之外的内容不符合检测到的编码，不再继续解码
+    FileEncoding detectedEncoding() const { return redetected; }   //编码检查失败后按全部内容检测到的编码
+
+signals:
+    void chunkReady();  //工作线程解码出了新的一段（在工作线程中发出）
+
+private:
+    void run();     //工作线程
+    bool map();     //建立映射
+    void startAt(qint64 from);  //从 from 处开始解码
+    qint64 chunkEnd(qint64 end, bool wholeLines) const;  //把一段的结尾调整到换行之后
+    void checkEncoding(qint64 end);    //检查已解码到 end 处的内容是否符合检测到的编码
+
+    struct Chunk {
+        QString text;
+        qint64 end; //该段结束处的字节偏移
+    };
+
+    QString path;
+    QSharedPointer<MappedFile> mapping;
+    const char *bytes;  //文件内容
+    qint64 length;
+    qint64 offset;
+    FileEncoding fileEncoding;
+    QTextDecoder *decoder;  //有状态的解码器，跨段的多字节字符不会被截断
+    bool lineStart;     //上一段在换行处结束，解码器中没有残留的字节
+    bool verify;        //解码时检查样本之外的内容
+    qint64 checked;     //已检查到的字节偏移
+    bool wrongEncoding;
+    FileEncoding redetected;
+
+    qint64 chunkSize;
+    QFuture<void> future;
+    QMutex mutex;   //保护以下成员
+    QWaitCondition notFull;
+    QQueue<Chunk> chunks;   //已解码、等待界面线程取走的内容
+    bool stopped;
+    bool finished;
+};
+
+#endif // FILELOADER_H
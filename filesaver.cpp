@@ -0,0 +1,111 @@
+#include <QTextCodec>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "filesaver.h"
+
+static const int MaxConcurrentSaves = 16;   // 同时写入的文件数
+
+// 写入主要是在等待磁盘或网络，保存使用单独的线程池，
+// 全部保存时多个文件可以同时写入，也不占用解码、查找等计算任务的线程
+Q_GLOBAL_STATIC(QThreadPool, globalSavePool)
+
+// 线程数只在第一次使用时设定（局部静态变量的初始化是线程安全的）
+static QThreadPool *savePool()
+{
+    static const bool configured = (globalSavePool()->setMaxThreadCount(MaxConcurrentSaves), true);
+    Q_UNUSED(configured);
+    return globalSavePool();
+}
+
+FileSaver::FileSaver(const PieceTable &snapshot, const QString &fileName,
+                     const FileEncoding &encoding, QObject *parent)
+    : QObject(parent), snapshot(snapshot), path(fileName), encoding(encoding),
+      done(false), success(false), stopped(0)
+{
+    // 在工作线程中发出，排队到界面线程处理
+    connect(this, SIGNAL(writeFinished()), this, SLOT(finish()));
+}
+
+FileSaver::~FileSaver()
+{
+    abort();
+}
+
+// 开始保存
+void FileSaver::start()
+{
+    future = QtConcurrent::run(savePool(), this, &FileSaver::run);
+}
+
+// 等待保存结束，返回是否成功
+bool FileSaver::waitForFinished()
+{
+    future.waitForFinished();
+    finish();
+    return success;
+}
+
+void FileSaver::finish()
+{
+    if (done) {
+        return;
+    }
+
+    future.waitForFinished();
+    done = true;
+    emit finished(success);
+}
+
+// 停止工作线程，QSaveFile 未提交的临时文件会被丢弃
+void FileSaver::abort()
+{
+    stopped.store(1);
+    future.waitForFinished();
+}
+
+void FileSaver::run()
+{
+    QSaveFile file(path);
+    bool ok = file.open(QIODevice::WriteOnly);
+    QTextCodec *codec = encoding.codec();
+    QTextEncoder *encoder = codec->makeEncoder(QTextCodec::IgnoreHeader);
+    qint64 written = 0;
+    int total = qMax(1, snapshot.length());
+
+    // 原文件带有字节序标记时照样写回
+    QByteArray bom = encoding.bom();
+    ok = ok && file.write(bom) == bom.size();
+
+    layout.setOriginal(QSharedPointer<MappedFile>(), encoding);
+    for (int i = 0; ok && i < snapshot.pieceCount(); ++i) {
+        if (stopped.load()) {
+            break;
+        }
+
+        ok = snapshot.writePiece(i, &file, codec, encoder, &layout);
+        written += snapshot.pieceLength(i);
+        emit progress(int(written * 100 / total));
+    }
+    delete encoder;
+
+    if (stopped.load()) {
+        file.cancelWriting();
+        return;
+    }
+
+    // 写入期间原文件被其他程序改动，未修改的部分读到的可能已不是文档中的内容，不能提交
+    if (ok && snapshot.isStale()) {
+        file.cancelWriting();
+        error = tr("The file was changed by another program while saving. Please save again.");
+        emit writeFinished();
+        return;
+    }
+
+    success = ok && file.commit();
+    if (!success) {
+        error = file.errorString();
+    }
+    emit writeFinished();
+}
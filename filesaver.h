@@ -0,0 +1,53 @@
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include <QObject>
+#include <QString>
+#include <QFuture>
+#include <QAtomicInt>
+
+#include "piecetable.h"
+
+// 在后台保存文档：工作线程把文档的快照（片段表）按文件原来的编码写入 QSaveFile，
+// 全部写完后原子地替换原文件，界面线程不参与写入
+class FileSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    FileSaver(const PieceTable &snapshot, const QString &fileName, const FileEncoding &encoding,
+              QObject *parent = 0);
+    ~FileSaver();
+
+    void start();   //开始保存
+    bool waitForFinished(); //等待保存结束，返回是否成功（关闭文档前调用）
+    bool isFinished() const { return done; }
+    QString fileName() const { return path; }
+    QString errorString() const { return error; }
+    const PieceTable &savedLayout() const { return layout; }  //各片段在新文件中的位置
+
+signals:
+    void progress(int percent);     //写入进度（在工作线程中发出）
+    void finished(bool success);    //保存结束
+    void writeFinished();   //工作线程已提交或放弃写入（内部使用）
+
+private slots:
+    void finish();  //处理保存结果
+
+private:
+    void run();     //工作线程：编码并写入
+    void abort();   //停止工作线程，丢弃临时文件
+
+    PieceTable snapshot;
+    PieceTable layout;
+    QString path;
+    FileEncoding encoding;
+    bool done;
+    bool success;
+    QString error;
+
+    QFuture<void> future;
+    QAtomicInt stopped; //要求工作线程放弃写入
+};
+
+#endif // FILESAVER_H
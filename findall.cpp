@@ -0,0 +1,116 @@
+#include <QtConcurrent>
+
+#include "findall.h"
+#include "patterncache.h"
+#include "literalmatcher.h"
+
+static const int WindowChars = 1024 * 1024;    // 每次从快照中取出的字符数
+
+FindAll::FindAll(QObject *parent)
+    : QObject(parent), cs(Qt::CaseSensitive), regExp(false), stopped(0), finished(false)
+{
+}
+
+FindAll::~FindAll()
+{
+    stop();
+}
+
+// 快照是片段表的副本，与文档共享原始文件的映射和追加缓冲，复制很快
+void FindAll::start(const PieceTable &table, const QString &str, bool matchCase, bool useRegExp)
+{
+    stop();
+
+    snapshot = table;
+    pattern = str;
+    cs = matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    regExp = useRegExp;
+    re = regExp ? PatternCache::pattern(str, matchCase) : QRegularExpression();
+    found.clear();
+    finished = false;
+    stopped.store(0);
+    future = QtConcurrent::run(this, &FindAll::run);
+}
+
+void FindAll::stop()
+{
+    stopped.store(1);
+    future.waitForFinished();
+}
+
+QVector<FindMatch> FindAll::takeMatches()
+{
+    QMutexLocker locker(&mutex);
+    QVector<FindMatch> matches;
+    matches.swap(found);
+    return matches;
+}
+
+bool FindAll::isFinished()
+{
+    QMutexLocker locker(&mutex);
+    return finished && found.isEmpty();
+}
+
+// 按窗口取出文本，窗口在换行处结束（正则表达式与查找一样逐行匹配）；
+// 一行长过一个窗口时，相邻窗口重叠 pattern.size() - 1 个字符，跨窗口的字符串不会漏掉
+void FindAll::run()
+{
+    LiteralMatcher matcher(pattern, cs);
+    int total = snapshot.length();
+    int overlap = regExp ? 0 : pattern.size() - 1;
+
+    for (int start = 0; start < total && !stopped.load(); ) {
+        QString text = snapshot.text(start, WindowChars);
+        int limit = text.size();    // 起点在 limit 之前的匹配属于这个窗口
+        if (start + text.size() < total) {
+            int lf = text.lastIndexOf(QLatin1Char('\n'));
+            limit = lf != -1 ? lf + 1 : qMax(1, text.size() - overlap);
+        }
+
+        QVector<FindMatch> batch;
+        if (regExp) {
+            for (int lineStart = 0; lineStart < limit; ) {
+                int lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+                if (lineEnd == -1 || lineEnd > limit) {
+                    lineEnd = limit;
+                }
+                QString line = text.mid(lineStart, lineEnd - lineStart);
+                for (int pos = 0; pos <= line.size(); ) {
+                    QRegularExpressionMatch result = re.match(line, pos);
+                    if (!result.hasMatch()) {
+                        break;
+                    }
+                    if (result.capturedLength() > 0) {   // 空匹配无法标记，不计入
+                        FindMatch match = { start + lineStart + result.capturedStart(), result.capturedLength() };
+                        batch.append(match);
+                    }
+                    pos = result.capturedEnd() + (result.capturedLength() == 0);
+                }
+                lineStart = lineEnd + 1;
+            }
+        } else {
+            for (int pos = matcher.indexIn(text.constData(), text.size(), 0); pos != -1 && pos < limit;
+                 pos = matcher.indexIn(text.constData(), text.size(), pos + pattern.size())) {
+                FindMatch match = { start + pos, pattern.size() };
+                batch.append(match);
+            }
+        }
+        start += limit;
+
+        if (!batch.isEmpty()) {
+            mutex.lock();
+            bool wasEmpty = found.isEmpty();    // 界面线程尚未取走上一批时不必再通知
+            found += batch;
+            mutex.unlock();
+            if (wasEmpty) {
+                emit matchesReady();
+            }
+        }
+    }
+
+    mutex.lock();
+    finished = true;
+    mutex.unlock();
+    emit matchesReady();
+}
@@ -0,0 +1,53 @@
+#ifndef FINDALL_H
+#define FINDALL_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QRegularExpression>
+
+#include "piecetable.h"
+
+// 一个匹配在文档中的位置
+struct FindMatch {
+    int position;
+    int length;
+};
+Q_DECLARE_TYPEINFO(FindMatch, Q_PRIMITIVE_TYPE);
+
+// 全部查找：在工作线程中扫描文档的快照（片段表的副本），找到的匹配分批交给界面线程，
+// 界面线程通过 takeMatches() 逐批取走
+class FindAll : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FindAll(QObject *parent = 0);
+    ~FindAll();
+
+    void start(const PieceTable &snapshot, const QString &str, bool matchCase, bool regExp); //开始查找
+    void stop();    //停止工作线程并等待其退出
+    QVector<FindMatch> takeMatches();   //取出工作线程新找到的匹配（按位置排序）
+    bool isFinished();  //已查找到末尾且匹配都已取走
+
+signals:
+    void matchesReady();    //找到了新的一批，或查找结束（在工作线程中发出）
+
+private:
+    void run();     //工作线程
+
+    PieceTable snapshot;
+    QString pattern;
+    Qt::CaseSensitivity cs;
+    bool regExp;
+    QRegularExpression re;  //编译好的表达式（隐式共享，工作线程只读）
+    QFuture<void> future;
+    QAtomicInt stopped;
+    QMutex mutex;   //保护以下成员
+    QVector<FindMatch> found;   //已找到、等待界面线程取走的匹配
+    bool finished;
+};
+
+#endif // FINDALL_H
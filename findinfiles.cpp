@@ -0,0 +1,320 @@
+#include <QDir>
+#include <QDirIterator>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <cstring>
+
+#include "findinfiles.h"
+#include "fileloader.h"
+#include "patterncache.h"
+#include "literalmatcher.h"
+
+static const int ChunkBytes = 4 * 1024 * 1024;  // 每次从文件中解码的字节数
+static const int WindowChars = 1024 * 1024;     // 每次从片段表中取出的字符数
+static const int BinaryProbeBytes = 8000;       // 开头这些字节中有 0 字节的文件当作二进制文件跳过
+static const int EnumerateBatch = 64;           // 列目录时每次加入队列的文件数
+static const int MaxMatchesPerFile = 10000;     // 一个文件最多报告的匹配数
+static const int MatchTextLength = 200;         // 结果中每行最多保留的字符数
+static const int MaxCarryChars = 1024 * 1024;   // 没有换行的一行超过这个长度时分段查找，不再整行留到下一段
+
+// 查找使用单独的线程池：读文件时常常在等待缺页，不占用高亮、全部查找等任务的线程
+Q_GLOBAL_STATIC(QThreadPool, globalSearchPool)
+
+// 每个处理器一个查找线程，另有一个列目录的线程；线程数只在第一次使用时设定
+static QThreadPool *searchPool()
+{
+    static const bool configured = (globalSearchPool()->setMaxThreadCount(QThread::idealThreadCount() + 1), true);
+    Q_UNUSED(configured);
+    return globalSearchPool();
+}
+
+// 逐段接收文本并按行查找，记下匹配所在的行号；一段末尾不完整的行留到下一段一起查。
+// 很长的一行（压缩过的 JSON、单行日志）不会整行留着：超过 MaxCarryChars 时先查已有的部分，
+// 字符串只留下可能跨段的 size() - 1 个字符，列号接着累计；正则表达式在分段处会被截断
+class LineSearcher
+{
+public:
+    LineSearcher(const LiteralMatcher &matcher, const QRegularExpression &re, bool regExp,
+                 QVector<FileMatch> *matches)
+        : matcher(matcher), re(re), regExp(regExp), matches(matches), line(1), column(0) {}
+
+    bool feed(const QString &chunk, bool last); //返回 false 表示匹配数已达上限，不必再查
+
+private:
+    void searchLiteral(const QString &text, int end);
+    void searchRegExp(const QString &text, int end);
+    void addMatch(const QString &text, int lineStart, int lineEnd, int position, int length);
+
+    const LiteralMatcher &matcher;
+    const QRegularExpression &re;
+    bool regExp;
+    QVector<FileMatch> *matches;
+    QString carry;  //上一段末尾不完整的行
+    qint64 line;    //下一段第一行的行号
+    int column;     //下一段的开头在这一行中的列（一行分段查找时不为 0）
+};
+
+// text 中 from 之后的第一个换行，没有或超过 end 时返回 end
+static int lineEndFrom(const QString &text, int from, int end)
+{
+    int lf = text.indexOf(QLatin1Char('\n'), from);
+    return lf == -1 || lf > end ? end : lf;
+}
+
+bool LineSearcher::feed(const QString &chunk, bool last)
+{
+    QString text = carry.isEmpty() ? chunk : carry + chunk;
+    int end = text.size();
+    if (!last) {
+        end = text.lastIndexOf(QLatin1Char('\n')) + 1;
+    }
+    bool split = end == 0 && text.size() > MaxCarryChars;  // 一行太长，先查已有的部分
+    if (split) {
+        end = qMax(1, text.size() - (regExp ? 0 : matcher.size() - 1));
+    }
+    carry = text.mid(end);
+
+    if (regExp) {
+        searchRegExp(text, end);
+    } else {
+        searchLiteral(text, end);
+    }
+    column = split ? column + end : 0;
+    return matches->size() < MaxMatchesPerFile;
+}
+
+// 在整段中查找字符串，只在找到时才数出所在的行
+void LineSearcher::searchLiteral(const QString &text, int end)
+{
+    int lineStart = 0;
+    int lineEnd = lineEndFrom(text, 0, end);
+    for (int pos = matcher.indexIn(text.constData(), text.size(), 0); pos != -1 && pos < end;
+         pos = matcher.indexIn(text.constData(), text.size(), pos + matcher.size())) {
+        while (lineEnd < pos) {
+            ++line;
+            lineStart = lineEnd + 1;
+            lineEnd = lineEndFrom(text, lineStart, end);
+        }
+        addMatch(text, lineStart, lineEnd, pos, matcher.size());
+        if (matches->size() >= MaxMatchesPerFile) {
+            return;
+        }
+    }
+    line += text.midRef(lineStart, end - lineStart).count(QLatin1Char('\n'));
+}
+
+// 正则表达式与查找一样逐行匹配
+void LineSearcher::searchRegExp(const QString &text, int end)
+{
+    for (int lineStart = 0; lineStart < end; ) {
+        int lineEnd = lineEndFrom(text, lineStart, end);
+        QString lineText = text.mid(lineStart, lineEnd - lineStart);
+        for (int pos = 0; pos <= lineText.size(); ) {
+            QRegularExpressionMatch result = re.match(lineText, pos);
+            if (!result.hasMatch()) {
+                break;
+            }
+            if (result.capturedLength() > 0) {   // 空匹配无法选中，不计入
+                addMatch(text, lineStart, lineEnd, lineStart + result.capturedStart(), result.capturedLength());
+                if (matches->size() >= MaxMatchesPerFile) {
+                    return;
+                }
+            }
+            pos = result.capturedEnd() + (result.capturedLength() == 0);
+        }
+        if (lineEnd < end) {
+            ++line;     // 分段查找时这一行还没有结束
+        }
+        lineStart = lineEnd + 1;
+    }
+}
+
+void LineSearcher::addMatch(const QString &text, int lineStart, int lineEnd, int position, int length)
+{
+    if (lineEnd > lineStart && text.at(lineEnd - 1) == QLatin1Char('\r')) {
+        --lineEnd;
+    }
+    FileMatch match = { line, position - lineStart + (lineStart == 0 ? column : 0), length,
+                        text.mid(lineStart, qMin(lineEnd - lineStart, MatchTextLength)) };
+    matches->append(match);
+}
+
+FindInFiles::FindInFiles(QObject *parent)
+    : QObject(parent), cs(Qt::CaseSensitive), regExp(false), stopped(0), searched(0),
+      enumerating(false), running(0), finished(false)
+{
+}
+
+FindInFiles::~FindInFiles()
+{
+    stop();
+}
+
+// 片段表的副本与文档共享原始文件的映射和追加缓冲，复制很快
+void FindInFiles::start(const QStringList &files, const QString &dir, const QStringList &filters,
+                        const QHash<QString, PieceTable> &tables, const QString &str,
+                        bool matchCase, bool useRegExp)
+{
+    stop();
+
+    directory = dir.isEmpty() ? QString() : QDir(dir).absolutePath();
+    nameFilters = filters;
+    buffers = tables;
+    pattern = str;
+    cs = matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    regExp = useRegExp;
+    re = regExp ? PatternCache::pattern(str, matchCase) : QRegularExpression();
+    found.clear();
+    finished = false;
+    pending = files;
+    enumerating = !directory.isEmpty();
+    stopped.store(0);
+    searched.store(0);
+
+    int workers = QThread::idealThreadCount();
+    running = workers;
+    if (enumerating) {
+        futures << QtConcurrent::run(searchPool(), this, &FindInFiles::enumerate);
+    }
+    for (int i = 0; i < workers; ++i) {
+        futures << QtConcurrent::run(searchPool(), this, &FindInFiles::work);
+    }
+}
+
+void FindInFiles::stop()
+{
+    stopped.store(1);
+    mutex.lock();
+    queued.wakeAll();
+    mutex.unlock();
+
+    for (int i = 0; i < futures.size(); ++i) {
+        futures[i].waitForFinished();
+    }
+    futures.clear();
+}
+
+QList<FileMatches> FindInFiles::takeResults()
+{
+    QMutexLocker locker(&mutex);
+    QList<FileMatches> results;
+    results.swap(found);
+    return results;
+}
+
+bool FindInFiles::isFinished()
+{
+    QMutexLocker locker(&mutex);
+    return finished && found.isEmpty();
+}
+
+// 边列边加入队列，查找线程不必等整个目录树列完
+void FindInFiles::enumerate()
+{
+    QDirIterator it(directory, nameFilters, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    QStringList batch;
+    while (!stopped.load() && it.hasNext()) {
+        batch << it.next();
+        if (batch.size() == EnumerateBatch || !it.hasNext()) {
+            mutex.lock();
+            pending += batch;
+            queued.wakeAll();
+            mutex.unlock();
+            batch.clear();
+        }
+    }
+
+    mutex.lock();
+    enumerating = false;
+    queued.wakeAll();
+    mutex.unlock();
+}
+
+bool FindInFiles::nextFile(QString *fileName)
+{
+    QMutexLocker locker(&mutex);
+    while (pending.isEmpty() && enumerating && !stopped.load()) {
+        queued.wait(&mutex);
+    }
+    if (pending.isEmpty() || stopped.load()) {
+        return false;
+    }
+    *fileName = pending.takeFirst();
+    return true;
+}
+
+void FindInFiles::work()
+{
+    LiteralMatcher matcher(pattern, cs);
+    QString fileName;
+    while (!stopped.load() && nextFile(&fileName)) {
+        FileMatches result;
+        result.fileName = fileName;
+        LineSearcher searcher(matcher, re, regExp, &result.matches);
+
+        QHash<QString, PieceTable>::const_iterator buffer = buffers.constFind(fileName);
+        if (buffer != buffers.constEnd()) {
+            searchBuffer(buffer.value(), &searcher);
+        } else {
+            searchFile(fileName, &searcher);
+        }
+        searched.ref();
+
+        if (!result.matches.isEmpty() && !stopped.load()) {
+            mutex.lock();
+            bool wasEmpty = found.isEmpty();    // 界面线程尚未取走上一批时不必再通知
+            found.append(result);
+            mutex.unlock();
+            if (wasEmpty) {
+                emit resultsReady();
+            }
+        }
+    }
+
+    mutex.lock();
+    bool last = --running == 0;
+    if (last) {
+        finished = true;
+    }
+    mutex.unlock();
+    if (last) {
+        emit resultsReady();
+    }
+}
+
+// 以内存映射方式分段解码，与打开文件时的解码相同（ASCII 快速路径）；
+// 编码只按开头和结尾的样本检测，不像可编辑的标签页那样检查其余内容，每个文件只读一遍
+void FindInFiles::searchFile(const QString &fileName, LineSearcher *searcher)
+{
+    FileLoader loader(fileName);
+    if (!loader.open(false)) {
+        return;
+    }
+    if (loader.encoding().isAsciiCompatible()) {
+        const char *data = loader.mappedFile()->data();
+        if (std::memchr(data, 0, size_t(qMin<qint64>(loader.size(), BinaryProbeBytes)))) {
+            return;
+        }
+    }
+
+    while (!stopped.load() && !loader.atEnd()) {
+        QString text = loader.read(ChunkBytes);
+        if (!searcher->feed(text, loader.atEnd())) {
+            break;
+        }
+    }
+}
+
+void FindInFiles::searchBuffer(const PieceTable &table, LineSearcher *searcher)
+{
+    int total = table.length();
+    for (int start = 0; start < total && !stopped.load(); ) {
+        QString text = table.text(start, WindowChars);
+        start += text.size();
+        if (!searcher->feed(text, start >= total) || text.isEmpty()) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef FINDINFILES_H
+#define FINDINFILES_H
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QRegularExpression>
+
+#include "piecetable.h"
+
+// 文件中的一个匹配
+struct FileMatch {
+    qint64 line;    // 行号（从 1 开始）
+    int column;     // 在该行中的位置（从 0 开始，按 UTF-16 字符计）
+    int length;
+    QString text;   // 该行的文本（过长时截断）
+};
+
+// 一个文件中找到的全部匹配
+struct FileMatches {
+    QString fileName;
+    QVector<FileMatch> matches;
+};
+
+class LineSearcher;
+
+// 在多个文件中查找：一个线程列出目录中的文件，其余线程从共同的队列中逐个取出文件查找，
+// 先查完的线程接着取下一个，大小不一的文件也能把各线程占满。文件以内存映射方式读取，
+// 不必打开标签页；有未保存修改的标签页查找其片段表的快照。每个文件的结果查完后交给界面线程，
+// 界面线程通过 takeResults() 逐批取走
+class FindInFiles : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFiles(QObject *parent = 0);
+    ~FindInFiles();
+
+    // 在 files 和 directory 下（含子目录）文件名符合 nameFilters 的文件中查找，directory 为空时只查 files；
+    // buffers 中的文件查找其中的内容而不读文件
+    void start(const QStringList &files, const QString &directory, const QStringList &nameFilters,
+               const QHash<QString, PieceTable> &buffers, const QString &str, bool matchCase, bool regExp);
+    void stop();    //停止所有线程并等待其退出
+    QList<FileMatches> takeResults();   //取出新查完的文件的结果（没有匹配的文件不在其中）
+    bool isFinished();  //全部文件已查完且结果都已取走
+    int searchedFiles() const { return searched.load(); }   //已查完的文件数
+
+signals:
+    void resultsReady();    //有文件查完，或查找结束（在工作线程中发出）
+
+private:
+    void enumerate();   //列出目录中的文件（工作线程）
+    void work();    //逐个取出文件查找（工作线程）
+    bool nextFile(QString *fileName);   //取出下一个文件，队列为空且已列完时返回 false
+    void searchFile(const QString &fileName, LineSearcher *searcher);   //读文件查找
+    void searchBuffer(const PieceTable &table, LineSearcher *searcher); //查找未保存的内容
+
+    QString directory;
+    QStringList nameFilters;
+    QHash<QString, PieceTable> buffers; //只读，各线程共享
+    QString pattern;
+    Qt::CaseSensitivity cs;
+    bool regExp;
+    QRegularExpression re;
+    QList<QFuture<void> > futures;
+    QAtomicInt stopped;
+    QAtomicInt searched;
+    QMutex mutex;   //保护以下成员
+    QWaitCondition queued;  //队列中加入了文件或已列完
+    QStringList pending;    //等待查找的文件
+    bool enumerating;   //目录尚未列完
+    int running;    //尚未退出的查找线程数
+    QList<FileMatches> found;   //已查完、等待界面线程取走的结果
+    bool finished;
+};
+
+#endif // FINDINFILES_H
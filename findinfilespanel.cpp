@@ -0,0 +1,121 @@
+#include <QTreeWidget>
+#include <QLabel>
+#include <QToolButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QDir>
+
+#include "findinfilespanel.h"
+
+// 结果项中保存的数据
+static const int FileNameRole = Qt::UserRole;       // 文件项：文件名
+static const int LineRole = Qt::UserRole + 1;       // 匹配项：行号
+static const int ColumnRole = Qt::UserRole + 2;     // 匹配项：列
+static const int LengthRole = Qt::UserRole + 3;     // 匹配项：长度
+
+FindInFilesPanel::FindInFilesPanel(QWidget *parent)
+    : QDockWidget(tr("Find Results"), parent), files(0), total(0)
+{
+    setObjectName("findInFilesPanel");
+
+    finder = new FindInFiles(this);
+    // 在工作线程中发出，排队到界面线程处理
+    connect(finder, SIGNAL(resultsReady()), this, SLOT(takeResults()));
+
+    QWidget *widget = new QWidget(this);
+    statusLabel = new QLabel(widget);
+    stopButton = new QToolButton(widget);
+    stopButton->setText(tr("Stop"));
+    stopButton->setEnabled(false);
+    connect(stopButton, SIGNAL(clicked()), this, SLOT(stop()));
+
+    tree = new QTreeWidget(widget);
+    tree->setHeaderHidden(true);
+    tree->setUniformRowHeights(true);
+    connect(tree, SIGNAL(itemActivated(QTreeWidgetItem*,int)), this, SLOT(activate(QTreeWidgetItem*)));
+
+    QHBoxLayout *statusLayout = new QHBoxLayout;
+    statusLayout->addWidget(statusLabel, 1);
+    statusLayout->addWidget(stopButton);
+    QVBoxLayout *layout = new QVBoxLayout(widget);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(statusLayout);
+    layout->addWidget(tree);
+    setWidget(widget);
+}
+
+void FindInFilesPanel::start(const QStringList &fileNames, const QString &directory, const QStringList &nameFilters,
+                             const QHash<QString, PieceTable> &buffers, const QString &str,
+                             bool matchCase, bool regExp)
+{
+    finder->stop();
+    finder->takeResults();
+    tree->clear();
+    files = total = 0;
+
+    finder->start(fileNames, directory, nameFilters, buffers, str, matchCase, regExp);
+    stopButton->setEnabled(true);
+    updateStatus();
+}
+
+void FindInFilesPanel::stop()
+{
+    finder->stop();
+    takeResults();
+}
+
+// 每个文件一项，其下是该文件中的匹配，显示为“行:列  该行的文本”
+void FindInFilesPanel::takeResults()
+{
+    QList<FileMatches> results = finder->takeResults();
+    for (int i = 0; i < results.size(); ++i) {
+        const FileMatches &result = results.at(i);
+        QTreeWidgetItem *fileItem = new QTreeWidgetItem(tree);
+        fileItem->setText(0, tr("%1 (%2)").arg(QDir::toNativeSeparators(result.fileName))
+                                          .arg(result.matches.size()));
+        fileItem->setData(0, FileNameRole, result.fileName);
+
+        QList<QTreeWidgetItem *> items;
+        items.reserve(result.matches.size());
+        for (int j = 0; j < result.matches.size(); ++j) {
+            const FileMatch &match = result.matches.at(j);
+            QTreeWidgetItem *item = new QTreeWidgetItem;
+            item->setText(0, tr("%1:%2  %3").arg(match.line).arg(match.column + 1).arg(match.text.simplified()));
+            item->setData(0, LineRole, match.line);
+            item->setData(0, ColumnRole, match.column);
+            item->setData(0, LengthRole, match.length);
+            items << item;
+        }
+        fileItem->addChildren(items);
+        fileItem->setExpanded(true);
+
+        ++files;
+        total += result.matches.size();
+    }
+
+    if (finder->isFinished()) {
+        stopButton->setEnabled(false);
+    }
+    updateStatus();
+}
+
+void FindInFilesPanel::activate(QTreeWidgetItem *item)
+{
+    QTreeWidgetItem *fileItem = item->parent();
+    if (!fileItem) {
+        return;
+    }
+    emit matchActivated(fileItem->data(0, FileNameRole).toString(), item->data(0, LineRole).toLongLong(),
+                        item->data(0, ColumnRole).toInt(), item->data(0, LengthRole).toInt());
+}
+
+void FindInFilesPanel::updateStatus()
+{
+    if (stopButton->isEnabled()) {
+        statusLabel->setText(tr("Searching... %n match(es) in %1 file(s), %2 file(s) searched", 0, total)
+                             .arg(files).arg(finder->searchedFiles()));
+    } else {
+        statusLabel->setText(tr("%n match(es) in %1 file(s), %2 file(s) searched", 0, total)
+                             .arg(files).arg(finder->searchedFiles()));
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef FINDINFILESPANEL_H
+#define FINDINFILESPANEL_H
+
+#include <QDockWidget>
+
+#include "findinfiles.h"
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QTreeWidget)
+QT_FORWARD_DECLARE_CLASS(QTreeWidgetItem)
+QT_FORWARD_DECLARE_CLASS(QLabel)
+QT_FORWARD_DECLARE_CLASS(QToolButton)
+QT_END_NAMESPACE
+
+// 在文件中查找的结果面板：按文件分组列出匹配，查找时陆续加入；激活一个匹配时发出 matchActivated
+class FindInFilesPanel : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFilesPanel(QWidget *parent = 0);
+
+    // 开始新的查找，清除上次的结果（参数见 FindInFiles::start）
+    void start(const QStringList &files, const QString &directory, const QStringList &nameFilters,
+               const QHash<QString, PieceTable> &buffers, const QString &str, bool matchCase, bool regExp);
+
+signals:
+    void matchActivated(const QString &fileName, qint64 line, int column, int length); //打开文件并选中这个匹配
+
+public slots:
+    void stop();    //停止查找，已找到的结果保留
+
+private slots:
+    void takeResults(); //加入新查完的文件的结果
+    void activate(QTreeWidgetItem *item);
+
+private:
+    void updateStatus();
+
+    FindInFiles *finder;
+    QTreeWidget *tree;
+    QLabel *statusLabel;
+    QToolButton *stopButton;
+    int files;  //有匹配的文件数
+    int total;  //匹配数
+};
+
+#endif // FINDINFILESPANEL_H
@@ -0,0 +1,90 @@
+#include <string.h>
+
+#include "keywordtable.h"
+
+static const int InitialCapacity = 64;
+
+KeywordTable::KeywordTable()
+    : count(0), operatorLength(0)
+{
+}
+
+void KeywordTable::insert(const QString &word, int format)
+{
+    if (word.isEmpty() || format < 0) {
+        return;
+    }
+    if ((count + 1) * 2 > entries.size()) {
+        rehash(qMax(InitialCapacity, entries.size() * 2));
+    }
+
+    uint mask = uint(entries.size() - 1);
+    for (uint i = hash(word.constData(), word.size()) & mask; ; i = (i + 1) & mask) {
+        Entry &entry = entries[int(i)];
+        if (entry.format == -1) {
+            entry.word = word;
+            entry.format = format;
+            ++count;
+            break;
+        }
+        if (entry.word == word) {
+            entry.format = format;
+            return;
+        }
+    }
+
+    if (!isWordChar(word.at(0))) {
+        operatorLength = qMax(operatorLength, word.size());
+    }
+}
+
+int KeywordTable::find(const QChar *word, int length) const
+{
+    if (!count || length <= 0) {
+        return -1;
+    }
+
+    uint mask = uint(entries.size() - 1);
+    for (uint i = hash(word, length) & mask; ; i = (i + 1) & mask) {
+        const Entry &entry = entries.at(int(i));
+        if (entry.format == -1) {
+            return -1;
+        }
+        if (entry.word.size() == length
+                && memcmp(entry.word.constData(), word, size_t(length) * sizeof(QChar)) == 0) {
+            return entry.format;
+        }
+    }
+}
+
+void KeywordTable::clear()
+{
+    entries.clear();
+    count = 0;
+    operatorLength = 0;
+}
+
+// FNV-1a
+uint KeywordTable::hash(const QChar *word, int length)
+{
+    uint h = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        h = (h ^ word[i].unicode()) * 16777619u;
+    }
+    return h;
+}
+
+void KeywordTable::rehash(int capacity)
+{
+    QVector<Entry> old = entries;
+    Entry empty;
+    empty.format = -1;
+    entries = QVector<Entry>(capacity, empty);
+    count = 0;
+
+    for (int i = 0; i < old.size(); ++i) {
+        if (old.at(i).format != -1) {
+            insert(old.at(i).word, old.at(i).format);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef KEYWORDTABLE_H
+#define KEYWORDTABLE_H
+
+#include <QString>
+#include <QVector>
+
+// 关键字表：开放寻址的哈希表，直接用文本中的字符（不复制）查出关键字对应的格式下标，查找时不分配内存
+class KeywordTable
+{
+public:
+    KeywordTable();
+
+    void insert(const QString &word, int format);   //加入关键字，重复时覆盖
+    int find(const QChar *word, int length) const;  //查找，没有时返回 -1
+    void clear();
+
+    int size() const { return count; }
+    int maxOperatorLength() const { return operatorLength; }   //最长的符号关键字（如 -> ）的长度
+
+    static bool isWordChar(QChar c) { return c.isLetterOrNumber() || c == QLatin1Char('_'); }
+
+private:
+    struct Entry {
+        QString word;
+        int format;     //空位为 -1
+    };
+
+    static uint hash(const QChar *word, int length);
+    void rehash(int capacity);
+
+    QVector<Entry> entries;     //容量总是 2 的幂，至多一半被占用
+    int count;
+    int operatorLength;
+};
+
+#endif // KEYWORDTABLE_H
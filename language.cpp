@@ -0,0 +1,228 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QFont>
+#include <QHash>
+#include <QRegularExpression>
+#include <QStringListModel>
+#include <QTextStream>
+#include <QDebug>
+
+#include "language.h"
+#include "builtinsyntax.h"
+
+// 扩展名（小写）对应的语言
+static const struct {
+    const char *suffix;
+    const char *language;
+} LanguageSuffixes[] = {
+    { "c", "C" }, { "h", "C" }, { "cc", "C" }, { "cpp", "C" }, { "cxx", "C" },
+    { "hh", "C" }, { "hpp", "C" }, { "hxx", "C" }, { "ino", "C" },
+    { "nc", "GCode" }, { "ngc", "GCode" }, { "gcode", "GCode" }, { "gc", "GCode" },
+    { "g", "GCode" }, { "tap", "GCode" }, { "cnc", "GCode" }, { "iso", "GCode" },
+    { "mpf", "GCode" }, { "spf", "GCode" }, { "ptp", "GCode" }, { "eia", "GCode" },
+};
+
+// 补全列表中的常用 G 代码
+static const char *const GCodeCompletions[] = {
+    "G00", "G01", "G02", "G03", "G04", "G17", "G18", "G19", "G20", "G21", "G28",
+    "G40", "G41", "G42", "G43", "G49", "G54", "G55", "G56", "G57", "G58", "G59",
+    "G80", "G81", "G82", "G83", "G84", "G90", "G91", "G94", "G95",
+    "M00", "M01", "M02", "M03", "M04", "M05", "M06", "M08", "M09", "M30", "M98", "M99",
+};
+
+Language::Language()
+    : completionModel(0)
+{
+}
+
+Language::~Language()
+{
+    delete completionModel;
+}
+
+// 建语言时使用：关键字逐个加入，同色的关键字共用一个格式
+class LanguageBuilder
+{
+public:
+    LanguageBuilder(const QString &name, KeywordLexer *lexer)
+        : language(new Language), lexer(lexer)
+    {
+        language->name = name;
+        language->lexer = QSharedPointer<const Lexer>(lexer);
+    }
+
+    int format(const QColor &color, bool bold = true)
+    {
+        QPair<QRgb, bool> key(color.rgb(), bold);
+        QHash<QPair<QRgb, bool>, int>::const_iterator it = colorFormats.constFind(key);
+        if (it == colorFormats.constEnd()) {
+            QTextCharFormat format;
+            if (bold) {
+                format.setFontWeight(QFont::Bold);
+            }
+            format.setForeground(color);
+            it = colorFormats.insert(key, language->formats.size());
+            language->formats.append(format);
+        }
+        return it.value();
+    }
+
+    void addKeyword(const QString &word, const QColor &color)
+    {
+        lexer->addKeyword(word, format(color));
+        language->keywords.append(word);
+        if (word == QLatin1String("//")) {
+            commentColor = color;
+        }
+    }
+
+    QColor keywordCommentColor() const { return commentColor; } //定义中 // 的颜色
+
+    LanguagePointer finish()
+    {
+        language->keywords.sort(Qt::CaseInsensitive);
+        language->keywords.removeDuplicates();
+        language->completionModel = new QStringListModel(language->keywords);
+        return language;
+    }
+
+private:
+    QSharedPointer<Language> language;
+    KeywordLexer *lexer; //由 language 持有
+    QHash<QPair<QRgb, bool>, int> colorFormats; //颜色在格式表中的下标
+    QColor commentColor;
+};
+
+static QTextCharFormat tokenFormat(const QColor &color, bool bold = false, bool italic = false)
+{
+    QTextCharFormat format;
+    format.setForeground(color);
+    if (bold) {
+        format.setFontWeight(QFont::Bold);
+    }
+    format.setFontItalic(italic);
+    return format;
+}
+
+// G 代码使用手写的词法分析器，格式表按 GCodeLexer::Token 的顺序
+static LanguagePointer gcodeLanguage()
+{
+    QSharedPointer<Language> language(new Language);
+    language->name = QLatin1String("GCode");
+    language->lexer = QSharedPointer<const Lexer>(new GCodeLexer);
+
+    language->formats.resize(GCodeLexer::TokenCount);
+    language->formats[GCodeLexer::Comment] = tokenFormat(QColor(0, 128, 0), false, true);
+    language->formats[GCodeLexer::GWord] = tokenFormat(QColor(0, 0, 255), true);
+    language->formats[GCodeLexer::MWord] = tokenFormat(QColor(128, 0, 128), true);
+    language->formats[GCodeLexer::AxisWord] = tokenFormat(QColor(160, 0, 0));
+    language->formats[GCodeLexer::FeedWord] = tokenFormat(QColor(200, 100, 0));
+    language->formats[GCodeLexer::ParameterWord] = tokenFormat(QColor(0, 128, 128));
+    language->formats[GCodeLexer::LineNumber] = tokenFormat(QColor(128, 128, 128));
+    language->formats[GCodeLexer::ProgramNumber] = tokenFormat(QColor(0, 100, 160), true);
+
+    for (const char *code : GCodeCompletions) {
+        language->keywords.append(QLatin1String(code));
+    }
+    language->completionModel = new QStringListModel(language->keywords);
+    return language;
+}
+
+static QHash<QString, LanguagePointer> &languages()
+{
+    static QHash<QString, LanguagePointer> table;
+    return table;
+}
+
+LanguagePointer LanguageRegistry::language(const QString &name)
+{
+    LanguagePointer &language = languages()[name];
+    if (!language && name == QLatin1String("GCode")) {
+        language = gcodeLanguage();
+    } else if (!language) {
+        const BuiltinSyntax *syntax = findBuiltinSyntax(name);
+        if (!syntax) {
+            languages().remove(name);
+            return LanguagePointer();
+        }
+
+        // C 的定义另外识别注释和字符串（可以跨行），注释使用定义中 // 的颜色
+        CLexer *cLexer = name == QLatin1String("C") ? new CLexer : 0;
+        LanguageBuilder builder(name, cLexer ? cLexer : new KeywordLexer);
+        for (int i = 0; i < syntax->count; ++i) {
+            const KeywordDefinition &keyword = syntax->keywords[i];
+            builder.addKeyword(QString::fromUtf8(keyword.word),
+                               QColor(keyword.r, keyword.g, keyword.b));
+        }
+        if (cLexer) {
+            QColor comment = builder.keywordCommentColor();
+            cLexer->setFormats(builder.format(comment.isValid() ? comment : QColor(0, 128, 58), false),
+                               builder.format(QColor(163, 21, 21), false));
+        }
+        language = builder.finish();
+    }
+    return language;
+}
+
+LanguagePointer LanguageRegistry::languageForFile(const QString &fileName)
+{
+    QByteArray suffix = QFileInfo(fileName).suffix().toLower().toLatin1();
+    for (const auto &entry : LanguageSuffixes) {
+        if (suffix == entry.suffix) {
+            LanguagePointer language = LanguageRegistry::language(QLatin1String(entry.language));
+            if (language) {
+                return language;
+            }
+        }
+    }
+    return plainText();
+}
+
+// 每行为“关键字 r g b”，以 $$ 开头的是注释；按文件的绝对路径缓存
+LanguagePointer LanguageRegistry::loadDefinition(const QString &fileName)
+{
+    QString path = QFileInfo(fileName).absoluteFilePath();
+    LanguagePointer &language = languages()[path];
+    if (language) {
+        return language;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Open file " << fileName << "error" << __FUNCTION__;
+        languages().remove(path);
+        return LanguagePointer();
+    }
+
+    QTextStream readFileStream(&file);
+    QRegularExpression re("[ ]+");
+    LanguageBuilder builder(QFileInfo(fileName).completeBaseName(), new KeywordLexer);
+    while (!readFileStream.atEnd()) {
+        QString readLineStr = readFileStream.readLine();
+        if (readLineStr.startsWith("$$")) { //comment line
+            continue;
+        }
+        readLineStr.replace("\t", " ");
+        QStringList lineWordList = readLineStr.split(re);
+        if (lineWordList.size() != 4) {
+            continue;
+        }
+        builder.addKeyword(lineWordList.at(0), QColor(lineWordList.at(1).toInt(),
+                                                      lineWordList.at(2).toInt(),
+                                                      lineWordList.at(3).toInt()));
+    }
+    language = builder.finish();
+    return language;
+}
+
+LanguagePointer LanguageRegistry::plainText()
+{
+    static LanguagePointer language;
+    if (!language) {
+        QSharedPointer<Language> plain(new Language);
+        plain->name = QLatin1String("Text");
+        plain->completionModel = new QStringListModel;
+        language = plain;
+    }
+    return language;
+}
@@ -0,0 +1,42 @@
+#ifndef LANGUAGE_H
+#define LANGUAGE_H
+
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTextCharFormat>
+#include <QVector>
+
+#include "lexer.h"
+
+QT_FORWARD_DECLARE_CLASS(QStringListModel)
+
+// 一种语言的语法定义：建好之后不再修改，所有标签页的高亮器和补全共享同一份
+class Language
+{
+public:
+    Language();
+    ~Language();
+
+    QString name;
+    QSharedPointer<const Lexer> lexer; //也与高亮的工作线程共享，为空时不高亮
+    QVector<QTextCharFormat> formats; //记号的格式，lexer 给出的是其中的下标
+    QStringList keywords; //补全列表，不分大小写排序
+    QStringListModel *completionModel; //补全列表的模型（只在界面线程使用）
+
+private:
+    Q_DISABLE_COPY(Language)
+};
+
+typedef QSharedPointer<const Language> LanguagePointer;
+
+// 进程内的语言表：每种语言第一次用到时建好，之后一直共享（只在界面线程使用）
+class LanguageRegistry
+{
+public:
+    static LanguagePointer language(const QString &name); //内置的语言（GCode 或编译进程序的定义），没有时返回空指针
+    static LanguagePointer languageForFile(const QString &fileName); //按扩展名选择，无法识别时为纯文本
+    static LanguagePointer loadDefinition(const QString &fileName); //用户提供的语法定义文件，读取失败时返回空指针
+    static LanguagePointer plainText(); //不高亮、没有补全
+};
+
+#endif // LANGUAGE_H
@@ -0,0 +1,425 @@
+#include <QApplication>
+#include <QScrollBar>
+#include <QTextCodec>
+#include <QTextBlock>
+#include <QByteArrayMatcher>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+#include "largefileview.h"
+#include "patterncache.h"
+
+static const int WindowLines = 4000;                // 每段最多的行数
+static const qint64 WindowBytes = 4 * 1024 * 1024;  // 每段最多的字节数
+static const int EdgeLines = 200;       // 离一段的边缘只剩这么多行时换一段
+static const int ContextLines = 1000;   // 换段时在第一个可见行之前保留的行数
+static const qint64 SearchChunk = 64 * 1024 * 1024; // 在映射中查找时每次的字节数
+
+LargeFileView::LargeFileView(MyGCodeTextEdit *parent)
+    : NotePad(parent), data(0), size(0), headerSize(0), windowStart(0), windowEnd(0),
+      windowLine(0), reloading(false), barScale(1), searchStopped(0), searching(false), searchLength(0)
+{
+    setReadOnly(true);
+    document()->setUndoRedoEnabled(false);
+
+    // 自带的滚动条只对应当前一段，隐藏起来，换成对应整个文件的滚动条
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    offsetBar = new QScrollBar(Qt::Vertical, this);
+    setExtraRightMargin(offsetBar->sizeHint().width());
+
+    connect(offsetBar, SIGNAL(actionTriggered(int)), this, SLOT(offsetBarMoved(int)));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(viewScrolled()));
+    index = new LineIndex(this);
+    connect(index, SIGNAL(progress()), this, SLOT(updateWindowLine()));
+    searchWatcher = new QFutureWatcher<qint64>(this);
+    connect(searchWatcher, SIGNAL(finished()), this, SLOT(searchFinished()));
+}
+
+// 关闭标签页时停下仍在扫描文件的工作线程，映射随之释放
+LargeFileView::~LargeFileView()
+{
+    stopSearch();
+    index->clear();
+}
+
+// 映射文件并显示开头的一段，行数在后台统计
+bool LargeFileView::openFile(const QString &fileName)
+{
+    file = QSharedPointer<MappedFile>(new MappedFile(fileName));
+    if (!file->isValid()) {
+        file.clear();
+        return false;
+    }
+
+    data = file->data();
+    size = file->size();
+    encoding = FileEncoding::detect(data, size, false);   // 只读，不会按这个编码写回
+    headerSize = encoding.bomLength();
+
+    // 滚动条的取值是 int，文件超过 2GB 时每一格对应多个字节
+    barScale = size / std::numeric_limits<int>::max() + 1;
+    offsetBar->setRange(0, int(size / barScale));
+
+    index->build(file, encoding);
+
+    seek(headerSize);
+    return true;
+}
+
+bool LargeFileView::saveFile(const QString &)
+{
+    emit saveFinished(false, tr("The file is opened in read-only large file view."));
+    return false;
+}
+
+void LargeFileView::resizeEvent(QResizeEvent *event)
+{
+    NotePad::resizeEvent(event);
+
+    QRect cr = contentsRect();
+    int width = offsetBar->sizeHint().width();
+    offsetBar->setGeometry(QRect(cr.right() - width + 1, cr.top(), width, cr.height()));
+}
+
+void LargeFileView::keyPressEvent(QKeyEvent *e)
+{
+    if (e->key() == Qt::Key_Escape && searching) {
+        stopSearch();
+        return;
+    }
+    if (e->matches(QKeySequence::MoveToStartOfDocument)) {
+        seek(headerSize);
+        return;
+    }
+    if (e->matches(QKeySequence::MoveToEndOfDocument)) {
+        seek(size);
+        moveCursor(QTextCursor::End);
+        return;
+    }
+    QPlainTextEdit::keyPressEvent(e);   // 只读，不需要自动补全
+}
+
+// 点击箭头和空白处时在当前一段中滚动，拖动时直接跳到对应的字节偏移
+void LargeFileView::offsetBarMoved(int action)
+{
+    switch (action) {
+        case QAbstractSlider::SliderSingleStepAdd:
+        case QAbstractSlider::SliderSingleStepSub:
+        case QAbstractSlider::SliderPageStepAdd:
+        case QAbstractSlider::SliderPageStepSub:
+            verticalScrollBar()->triggerAction(QAbstractSlider::SliderAction(action));
+            break;
+        case QAbstractSlider::SliderToMinimum:
+            seek(headerSize);
+            break;
+        case QAbstractSlider::SliderToMaximum:
+            seek(size);
+            break;
+        default:
+            seek(qint64(offsetBar->sliderPosition()) * barScale);
+            return;
+    }
+
+    int first = qBound(0, verticalScrollBar()->value(), lineOffsets.size() - 1);
+    offsetBar->setSliderPosition(int(lineOffsets.at(first) / barScale));
+}
+
+// 滚动到当前一段的边缘时换一段，第一个可见行和光标位置保持不变
+void LargeFileView::viewScrolled()
+{
+    if (reloading || lineOffsets.isEmpty()) {
+        return;
+    }
+
+    int first = qMin(verticalScrollBar()->value(), lineOffsets.size() - 1);
+    int visible = viewport()->height() / qMax(1, fontMetrics().height());
+    bool nearTop = first < EdgeLines && windowStart > headerSize;
+    bool nearBottom = first + visible > lineOffsets.size() - EdgeLines && windowEnd < size;
+
+    if (nearTop || nearBottom) {
+        QTextCursor cursor = textCursor();
+        int line = cursor.blockNumber();
+        qint64 cursorLine = line < lineOffsets.size() ? lineOffsets.at(line) : -1;
+        seek(lineOffsets.at(first), cursorLine, cursor.positionInBlock());
+    } else {
+        syncOffsetBar();
+    }
+}
+
+// 显示 offset 所在的行（作为第一个可见行），光标放在 cursorLine 行的 column 列
+void LargeFileView::seek(qint64 offset, qint64 cursorLine, int column)
+{
+    qint64 top = lineStart(qBound(headerSize, offset, size));
+    loadWindow(linesBack(top, ContextLines));
+
+    int line = int(std::upper_bound(lineOffsets.begin(), lineOffsets.end(), top)
+                   - lineOffsets.begin()) - 1;
+    int target = line;
+    if (cursorLine >= 0) {
+        QVector<qint64>::const_iterator it = std::lower_bound(lineOffsets.constBegin(),
+                                                              lineOffsets.constEnd(), cursorLine);
+        if (it != lineOffsets.constEnd() && *it == cursorLine) {
+            target = int(it - lineOffsets.constBegin());
+        }
+    }
+
+    reloading = true;
+    QTextBlock block = document()->findBlockByNumber(qMax(0, target));
+    QTextCursor cursor(block);
+    cursor.setPosition(block.position() + qBound(0, column, block.length() - 1));
+    setTextCursor(cursor);
+    verticalScrollBar()->setValue(qMax(0, line));
+    reloading = false;
+
+    syncOffsetBar();
+}
+
+// 从 start 开始取出完整的若干行（最多 WindowLines 行、WindowBytes 字节）放入文档
+void LargeFileView::loadWindow(qint64 start)
+{
+    qint64 limit = qMin(size, start + WindowBytes);
+    qint64 pos = start;
+
+    lineOffsets.clear();
+    do {
+        lineOffsets << pos;
+        qint64 next = nextLine(pos, limit);
+        if (next == -1) {
+            if (limit == size) {
+                pos = size;     // 文件的最后一行
+            } else if (lineOffsets.size() == 1) {
+                // 一行比一段还长，截断显示
+                pos = limit;
+                if (encoding.unitSize() == 2) {
+                    pos -= (pos - start) % 2;
+                } else {
+                    while (pos > start && (uchar(data[pos]) & 0xC0) == 0x80) {
+                        --pos;
+                    }
+                }
+            } else {
+                lineOffsets.removeLast();   // 留到下一段
+            }
+            break;
+        }
+        pos = next;
+    } while (pos < size && lineOffsets.size() < WindowLines);
+
+    windowStart = start;
+    windowEnd = pos;
+
+    QString text = encoding.codec()->toUnicode(data + windowStart, int(windowEnd - windowStart));
+    if (windowEnd < size && text.endsWith(QLatin1Char('\n'))) {
+        text.chop(text.endsWith(QLatin1String("\r\n")) ? 2 : 1);   // 不要多出一个空行
+    }
+
+    reloading = true;
+    replaceContents(text);
+    reloading = false;
+
+    // 滚动条翻一页大约对应一屏的字节数
+    qint64 lineBytes = (windowEnd - windowStart) / qMax(1, lineOffsets.size());
+    int visible = viewport()->height() / qMax(1, fontMetrics().height());
+    offsetBar->setSingleStep(int(qMax<qint64>(1, lineBytes * 3 / barScale)));
+    offsetBar->setPageStep(int(qMax<qint64>(1, lineBytes * visible / barScale)));
+
+    updateWindowLine();
+}
+
+void LargeFileView::syncOffsetBar()
+{
+    if (offsetBar->isSliderDown() || lineOffsets.isEmpty()) {
+        return; // 正在拖动，不要让滑块跳动
+    }
+
+    int first = qBound(0, verticalScrollBar()->value(), lineOffsets.size() - 1);
+    offsetBar->setValue(int(lineOffsets.at(first) / barScale));
+}
+
+// 后台统计到当前一段之前的位置后，算出这一段第一行的行号
+void LargeFileView::updateWindowLine()
+{
+    qint64 line = index->lineAt(windowStart);
+    if (line != windowLine || index->isFinished()) {
+        windowLine = line;
+        updateLineNumbers();
+    }
+}
+
+qint64 LargeFileView::lineStart(qint64 offset) const
+{
+    int unit = encoding.unitSize();
+    qint64 floor = qMax(headerSize, offset - WindowBytes);
+
+    for (qint64 pos = offset - unit; pos >= floor; pos -= unit) {
+        if (nextLine(pos, pos + unit) != -1) {
+            return pos + unit;
+        }
+    }
+    return floor == headerSize ? headerSize : offset - (offset - headerSize) % unit;
+}
+
+qint64 LargeFileView::linesBack(qint64 offset, int count) const
+{
+    qint64 floor = qMax(headerSize, offset - WindowBytes / 2);
+    qint64 pos = offset;
+
+    while (count-- > 0 && pos > floor) {
+        pos = lineStart(pos - encoding.unitSize());
+    }
+    return qMax(pos, headerSize);
+}
+
+// pos 之后第一个换行的下一个字节，limit 之前没有换行时返回 -1
+qint64 LargeFileView::nextLine(qint64 pos, qint64 limit) const
+{
+    if (encoding.unitSize() == 1) {
+        const void *lf = memchr(data + pos, '\n', size_t(qMax<qint64>(0, limit - pos)));
+        return lf ? static_cast<const char *>(lf) - data + 1 : -1;
+    }
+
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    bool big = encoding.isBigEndian();
+    for (; pos + 1 < limit; pos += 2) {
+        if (big ? (p[pos] == 0 && p[pos + 1] == '\n') : (p[pos] == '\n' && p[pos + 1] == 0)) {
+            return pos + 2;
+        }
+    }
+    return -1;
+}
+
+qint64 LargeFileView::lineCount() const
+{
+    qint64 lines = index->lineCount();
+    return lines < 0 ? MyGCodeTextEdit::lineCount() : lines;
+}
+
+// 由换行索引直接求出该行的字节偏移，行数还没有统计到那里时不能跳转
+bool LargeFileView::goToLine(qint64 line)
+{
+    qint64 offset = index->lineOffset(line - 1);
+    if (offset < 0) {
+        return false;
+    }
+    seek(offset, offset, 0);
+    return true;
+}
+
+// 文档中只有当前一段，内容随滚动替换，全部查找的位置无法保持
+void LargeFileView::findAll(QString, bool, bool)
+{
+    emit findAllFinished(0);
+}
+
+// 查找可能要翻过整个文件，不适合每输入一个字符就进行一次
+void LargeFileView::incrementalSearch(QString, bool, bool)
+{
+}
+
+// 查找：区分大小写的字符串按编码后的字节直接在映射中查找，范围是整个文件，在工作线程中进行，
+// 按 Esc、再次查找或关闭标签页时停止。多字节字符的尾字节不会与 ASCII 或首字节相同的编码
+// （UTF-8、Latin-1）才能这样查找，GB18030 的尾字节可能是 ASCII，匹配可能从字符中间开始。
+// 其余情况（正则表达式、不区分大小写、其他编码）只在当前一段中查找
+int LargeFileView::search(QString str, bool backward, bool matchCase, bool regExp)
+{
+    QTextCursor cursor = textCursor();
+    stopSearch();
+
+    if (regExp || !matchCase || !encoding.isAsciiCompatible() || encoding.codec()->mibEnum() == 114
+            || str.isEmpty()) {
+        QTextDocument::FindFlags options;
+        if (backward) {
+            options = QTextDocument::FindBackward;
+        }
+        if (matchCase) {
+            options |= QTextDocument::FindCaseSensitively;
+        }
+        cursor = regExp ? document()->find(PatternCache::pattern(str, matchCase), cursor, options) :
+                          document()->find(str, cursor, options);
+        if (cursor.isNull()) {
+            return false;
+        }
+        setTextCursor(cursor);
+        return true;
+    }
+
+    QByteArray needle = encoding.codec()->fromUnicode(str);
+    int position = backward ? cursor.selectionStart() : cursor.selectionEnd();
+    QTextBlock block = document()->findBlock(position);
+    int line = qBound(0, block.blockNumber(), lineOffsets.size() - 1);
+    qint64 from = lineOffsets.at(line) + encoding.codec()->fromUnicode(
+                block.text().left(position - block.position())).size();
+
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    searching = true;
+    searchLength = str.size();
+    searchStopped.store(0);
+    searchWatcher->setFuture(QtConcurrent::run(this, &LargeFileView::scan, file, needle, from, backward));
+    return true;
+}
+
+// 每次查找 SearchChunk 字节，相邻两次重叠 needle.size() - 1 个字节，之间检查是否要停止；
+// mapped 保证查找期间映射不被释放
+qint64 LargeFileView::scan(QSharedPointer<MappedFile> mapped, QByteArray needle, qint64 from, bool backward)
+{
+    const char *bytes = mapped->data();
+    qint64 length = mapped->size();
+
+    if (!backward) {
+        QByteArrayMatcher matcher(needle);
+        for (qint64 pos = from; pos < length && !searchStopped.load(); pos += SearchChunk) {
+            int n = int(qMin(length - pos, SearchChunk + needle.size() - 1));
+            int i = matcher.indexIn(bytes + pos, n);
+            if (i != -1) {
+                return pos + i;
+            }
+        }
+        return -1;
+    }
+
+    for (qint64 end = from; end > headerSize && !searchStopped.load(); end -= SearchChunk) {
+        qint64 pos = qMax(headerSize, end - SearchChunk);
+        int n = int(qMin(length - pos, end - pos + needle.size() - 1));
+        int i = QByteArray::fromRawData(bytes + pos, n).lastIndexOf(needle, int(end - pos - 1));
+        if (i != -1) {
+            return pos + i;
+        }
+    }
+    return -1;
+}
+
+void LargeFileView::stopSearch()
+{
+    if (!searching) {
+        return;
+    }
+    searchStopped.store(1);
+    searchWatcher->waitForFinished();
+    searching = false;
+    QApplication::restoreOverrideCursor();
+}
+
+void LargeFileView::searchFinished()
+{
+    if (!searching || !searchWatcher->isFinished()) {
+        return; // 已被停止，或是上一次查找迟到的通知
+    }
+    searching = false;
+    QApplication::restoreOverrideCursor();
+
+    qint64 found = searchWatcher->result();
+    if (found == -1) {
+        return;
+    }
+
+    qint64 start = lineStart(found);
+    int column = encoding.codec()->toUnicode(data + start, int(found - start)).size();
+    seek(start, start, column);
+
+    QTextCursor cursor = textCursor();
+    cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, searchLength);
+    setTextCursor(cursor);
+}
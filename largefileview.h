@@ -0,0 +1,83 @@
+#ifndef LARGEFILEVIEW_H
+#define LARGEFILEVIEW_H
+
+#include <QVector>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+
+#include "notepad.h"
+#include "mappedfile.h"
+#include "encoding.h"
+#include "lineindex.h"
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QScrollBar)
+QT_END_NAMESPACE
+
+// 超大文件的只读视图：文件只做内存映射，文档中只放当前位置附近的一段行，
+// 滚动到这段的边缘时换一段；右侧的滚动条对应文件中的字节偏移
+class LargeFileView : public NotePad
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileView(MyGCodeTextEdit *parent = 0);
+    ~LargeFileView();
+
+    bool openFile(const QString &fileName); //映射文件并显示开头的一段
+    bool saveFile(const QString &fileName) override; //只读，不能保存
+    qint64 fileSize() const { return size; }
+    qint64 lineCount() const override; //统计完成前按当前一段计算
+    bool goToLine(qint64 line) override;
+
+public slots:
+    int search(QString str, bool backward, bool matchCase, bool regExp) override;
+    void findAll(QString str, bool matchCase, bool regExp) override; //不支持，直接报告没有结果
+    void incrementalSearch(QString str, bool matchCase, bool regExp) override; //不支持，按“查找下一个”时再查找
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *e) override;
+    qint64 lineNumberOffset() const override { return windowLine; }
+
+private slots:
+    void offsetBarMoved(int action); //拖动或点击右侧的滚动条
+    void viewScrolled(); //在当前一段中滚动
+    void updateWindowLine(); //后台统计到当前位置后显示行号
+    void searchFinished(); //后台查找结束，选中找到的匹配
+
+private:
+    void seek(qint64 offset, qint64 cursorLine = -1, int column = 0); //显示 offset 所在的行，光标放在 cursorLine 行
+    void loadWindow(qint64 start); //从 start 开始解码一段行放入文档
+    void syncOffsetBar();
+    qint64 lineStart(qint64 offset) const; //offset 所在行的行首
+    qint64 linesBack(qint64 offset, int count) const; //向前 count 行的行首
+    qint64 nextLine(qint64 offset, qint64 limit) const; //下一行的行首，limit 之内没有时返回 -1
+    qint64 scan(QSharedPointer<MappedFile> mapped, QByteArray needle, qint64 from, bool backward); //在映射中查找（工作线程）
+    void stopSearch(); //停止后台查找并等待其退出
+
+    QSharedPointer<MappedFile> file;
+    FileEncoding encoding;
+    const char *data;
+    qint64 size;
+    qint64 headerSize; //字节序标记
+
+    qint64 windowStart; //当前一段在文件中的范围
+    qint64 windowEnd;
+    QVector<qint64> lineOffsets; //当前一段中各行的行首
+    qint64 windowLine; //当前一段之前的行数，未知时为 -1
+    bool reloading;
+
+    QScrollBar *offsetBar;
+    qint64 barScale; //滚动条每一格对应的字节数
+
+    LineIndex *index; //在后台统计的换行索引
+
+    QFutureWatcher<qint64> *searchWatcher; //在整个文件中查找的工作线程
+    QAtomicInt searchStopped;
+    bool searching;
+    int searchLength; //正在查找的字符串的长度（字符数）
+};
+
+#endif // LARGEFILEVIEW_H
@@ -0,0 +1,251 @@
+#include "lexer.h"
+
+void KeywordLexer::addKeyword(const QString &word, int format)
+{
+    keywords.insert(word, format);
+}
+
+// 关键字没有跨行的结构，状态原样返回
+int KeywordLexer::lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const
+{
+    const QChar *p = text;
+    int i = 0;
+
+    while (i < length) {
+        int start = i;
+        int format = -1;
+
+        if (p[i].isDigit()) {
+            // 数字（包括 0x1F、1.5e3 这样的写法）整个按第一个数字的格式显示
+            while (i < length && (KeywordTable::isWordChar(p[i]) || p[i] == QLatin1Char('.'))) {
+                ++i;
+            }
+            format = keywords.find(p + start, i - start);
+            if (format == -1) {
+                format = keywords.find(p + start, 1);
+            }
+        } else if (KeywordTable::isWordChar(p[i])) {
+            while (i < length && KeywordTable::isWordChar(p[i])) {
+                ++i;
+            }
+            int word = i;
+
+            // 带点的关键字（如 stdio.h）先按整体查找，找不到时只取第一段
+            while (i + 1 < length && p[i] == QLatin1Char('.') && KeywordTable::isWordChar(p[i + 1])) {
+                for (++i; i < length && KeywordTable::isWordChar(p[i]); ++i) {
+                }
+            }
+            if (i > word) {
+                format = keywords.find(p + start, i - start);
+                if (format == -1) {
+                    i = word;
+                }
+            }
+            if (format == -1) {
+                format = keywords.find(p + start, i - start);
+            }
+        } else if (!p[i].isSpace()) {
+            for (int n = qMin(keywords.maxOperatorLength(), length - i); n > 0; --n) {
+                format = keywords.find(p + start, n);
+                if (format != -1) {
+                    i += n;
+                    break;
+                }
+            }
+            if (format == -1) {
+                ++i;
+            }
+        } else {
+            ++i;
+        }
+
+        if (format != -1) {
+            TokenSpan span = { start, i - start, format };
+            spans->append(span);
+        }
+    }
+    return state;
+}
+
+CLexer::CLexer()
+    : commentFormat(-1), stringFormat(-1)
+{
+}
+
+void CLexer::setFormats(int comment, int string)
+{
+    commentFormat = comment;
+    stringFormat = string;
+}
+
+// 注释和字符串之间的代码按关键字表着色
+void CLexer::lexCode(const QChar *text, int start, int end, QVector<TokenSpan> *spans) const
+{
+    if (start >= end) {
+        return;
+    }
+    int first = spans->size();
+    KeywordLexer::lexLine(text + start, end - start, Code, spans);
+    for (int i = first; i < spans->size(); ++i) {
+        (*spans)[i].start += start;
+    }
+}
+
+int CLexer::commentEnd(const ushort *p, int from, int length)
+{
+    for (int i = from; i + 1 < length; ++i) {
+        if (p[i] == '*' && p[i + 1] == '/') {
+            return i + 2;
+        }
+    }
+    return -1;
+}
+
+// 转义的字符跳过；转义的是行末的换行时为续行
+int CLexer::quotedEnd(const ushort *p, int from, int length, ushort quote)
+{
+    int i = from;
+    for (; i < length; ++i) {
+        if (p[i] == '\\') {
+            ++i;
+        } else if (p[i] == quote) {
+            return i + 1;
+        }
+    }
+    return i > length ? Continued : Unclosed;
+}
+
+// 行末的状态只取决于这一行和上一行的状态，QSyntaxHighlighter 在某一块的状态不变时停止向后高亮，
+// 不在可见范围内的块又只标记为尚未高亮（见 MySyntaxHighlighterEditor），每次输入的工作量因此有上限
+int CLexer::lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const
+{
+    const ushort *p = reinterpret_cast<const ushort *>(text);
+    int i = 0;
+
+    if (state == InComment) {
+        int end = commentEnd(p, 0, length);
+        i = end == -1 ? length : end;
+        if (i > 0) {
+            TokenSpan span = { 0, i, commentFormat };
+            spans->append(span);
+        }
+        if (end == -1) {
+            return InComment;
+        }
+    } else if (state == InString) {
+        int end = quotedEnd(p, 0, length, '"');
+        i = end < 0 ? length : end;
+        if (i > 0) {
+            TokenSpan span = { 0, i, stringFormat };
+            spans->append(span);
+        }
+        if (end < 0) {
+            return end == Continued ? InString : Code;
+        }
+    }
+
+    int code = i;
+    while (i < length) {
+        ushort c = p[i];
+        if (c == '/' && i + 1 < length && p[i + 1] == '/') {
+            lexCode(text, code, i, spans);
+            TokenSpan span = { i, length - i, commentFormat };
+            spans->append(span);
+            return Code;
+        } else if (c == '/' && i + 1 < length && p[i + 1] == '*') {
+            lexCode(text, code, i, spans);
+            int end = commentEnd(p, i + 2, length);
+            TokenSpan span = { i, (end == -1 ? length : end) - i, commentFormat };
+            spans->append(span);
+            if (end == -1) {
+                return InComment;
+            }
+            i = code = end;
+        } else if (c == '"' || c == '\'') {
+            lexCode(text, code, i, spans);
+            int end = quotedEnd(p, i + 1, length, c);
+            TokenSpan span = { i, (end < 0 ? length : end) - i, stringFormat };
+            spans->append(span);
+            if (end < 0) {
+                // 只有字符串可以续行，没有闭合的字符常量到行尾为止
+                return c == '"' && end == Continued ? InString : Code;
+            }
+            i = code = end;
+        } else {
+            ++i;
+        }
+    }
+    lexCode(text, code, length, spans);
+    return Code;
+}
+
+int GCodeLexer::addressToken(ushort letter)
+{
+    switch (letter) {
+    case 'G': return GWord;
+    case 'M': return MWord;
+    case 'X': case 'Y': case 'Z': case 'A': case 'B': case 'C':
+    case 'U': case 'V': case 'W': case 'I': case 'J': case 'K': case 'R':
+        return AxisWord;
+    case 'F': case 'S': case 'T': return FeedWord;
+    case 'N': return LineNumber;
+    case 'O': return ProgramNumber;
+    default: return ParameterWord;
+    }
+}
+
+// 注释不跨行（括号注释没有闭合时到行尾为止），状态原样返回
+int GCodeLexer::lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const
+{
+    const ushort *p = reinterpret_cast<const ushort *>(text);
+    int i = 0;
+
+    while (i < length) {
+        int start = i;
+        ushort c = p[i++];
+        int token = -1;
+
+        if (c == ';') {
+            i = length;
+            token = Comment;
+        } else if (c == '(') {
+            while (i < length && p[i] != ')') {
+                ++i;
+            }
+            if (i < length) {
+                ++i;
+            }
+            token = Comment;
+        } else if (c == '%') {
+            token = ProgramNumber;
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') {
+            // 地址字母后面跟数值：可以有空格、正负号和小数点
+            int j = i;
+            while (j < length && (p[j] == ' ' || p[j] == '\t')) {
+                ++j;
+            }
+            if (j < length && (p[j] == '+' || p[j] == '-')) {
+                ++j;
+            }
+            int digits = j;
+            while (j < length && ((p[j] >= '0' && p[j] <= '9') || p[j] == '.')) {
+                ++j;
+            }
+            if (j > digits) {
+                i = j;
+                token = addressToken(c & ~0x20);
+            } else {
+                // 不是地址（如宏语句中的关键字），整个单词跳过
+                while (i < length && ((p[i] | 0x20) >= 'a' && (p[i] | 0x20) <= 'z')) {
+                    ++i;
+                }
+            }
+        }
+
+        if (token != -1) {
+            TokenSpan span = { start, i - start, token };
+            spans->append(span);
+        }
+    }
+    return state;
+}
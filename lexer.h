@@ -0,0 +1,86 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <QString>
+#include <QVector>
+
+#include "keywordtable.h"
+
+// 一行中的一段记号：格式是高亮器格式表中的下标
+struct TokenSpan {
+    int start;
+    int length;
+    int format;
+};
+Q_DECLARE_TYPEINFO(TokenSpan, Q_PRIMITIVE_TYPE);
+
+// 词法分析器：建好之后只读，可以在多个线程中同时使用
+class Lexer
+{
+public:
+    virtual ~Lexer() {}
+
+    // 分析一行，state 是上一行结束时的状态，返回这一行结束时的状态
+    virtual int lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const = 0;
+};
+
+// 按关键字表着色：标识符、数字按整个单词查表，其余字符按最长的符号关键字查表
+class KeywordLexer : public Lexer
+{
+public:
+    void addKeyword(const QString &word, int format);
+    int lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const override;
+
+private:
+    KeywordTable keywords;
+};
+
+// C 语言：在关键字之外识别注释和字符串，块注释和用 \ 续行的字符串可以跨行，
+// 行末的状态记下这一行结束时是否仍在其中
+class CLexer : public KeywordLexer
+{
+public:
+    enum State {
+        Code = 0,
+        InComment,  //块注释尚未结束
+        InString    //字符串在行末用 \ 续行
+    };
+
+    CLexer();
+    void setFormats(int comment, int string); //注释和字符串的格式下标
+    int lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const override;
+
+private:
+    void lexCode(const QChar *text, int start, int end, QVector<TokenSpan> *spans) const;
+    static int commentEnd(const ushort *p, int from, int length); //块注释结束处（*/ 之后），没有时返回 -1
+    enum { Unclosed = -1, Continued = -2 };
+    static int quotedEnd(const ushort *p, int from, int length, ushort quote); //引号之后，行末仍未结束时返回 Unclosed 或 Continued
+
+    int commentFormat;
+    int stringFormat;
+};
+
+// G 代码：一遍扫描，地址字母和后面的数值作为一个记号，( ) 和 ; 为注释
+// 格式下标固定为 Token 中的值，语言按这个顺序建格式表
+class GCodeLexer : public Lexer
+{
+public:
+    enum Token {
+        Comment,        //( ) 和 ; 注释
+        GWord,          //G 指令
+        MWord,          //M 指令
+        AxisWord,       //坐标轴和圆弧参数：X Y Z A B C U V W I J K R
+        FeedWord,       //进给、转速、刀具：F S T
+        ParameterWord,  //其他地址，如 P Q L H D
+        LineNumber,     //N 顺序号
+        ProgramNumber,  //O 程序号和 % 程序分隔符
+        TokenCount
+    };
+
+    int lexLine(const QChar *text, int length, int state, QVector<TokenSpan> *spans) const override;
+
+private:
+    static int addressToken(ushort letter); //地址字母（大写）对应的记号
+};
+
+#endif // LEXER_H
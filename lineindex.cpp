@@ -0,0 +1,209 @@
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <string.h>
+
+#include "lineindex.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINEINDEX_SSE2
+#endif
+
+static const qint64 BlockSize = 4 * 1024 * 1024;    // 每块的字节数
+static const int ReportBlocks = 64;     // 每统计这么多块通知一次
+
+LineIndex::LineIndex(QObject *parent)
+    : QObject(parent), stopped(0), finished(false)
+{
+}
+
+LineIndex::~LineIndex()
+{
+    clear();
+}
+
+// 在线程池中统计换行，统计到的部分马上可以使用
+void LineIndex::build(const QSharedPointer<MappedFile> &mappedFile, const FileEncoding &fileEncoding)
+{
+    clear();
+
+    file = mappedFile;
+    encoding = fileEncoding;
+    stopped.store(0);
+    future = QtConcurrent::run(this, &LineIndex::run);
+}
+
+void LineIndex::clear()
+{
+    stopped.store(1);
+    future.waitForFinished();
+
+    file.clear();
+    blockLines.clear();
+    finished = false;
+}
+
+bool LineIndex::isFinished() const
+{
+    QMutexLocker locker(&mutex);
+    return finished;
+}
+
+qint64 LineIndex::lineCount() const
+{
+    QMutexLocker locker(&mutex);
+    return finished ? blockLines.last() + 1 : -1;
+}
+
+qint64 LineIndex::lineAt(qint64 offset) const
+{
+    qint64 block = offset / BlockSize;
+
+    mutex.lock();
+    qint64 before = block < blockLines.size() ? blockLines.at(int(block)) : -1;
+    mutex.unlock();
+
+    if (before < 0 || !file || offset > file->size()) {
+        return -1;
+    }
+    return before + countNewlines(file->data() + block * BlockSize, offset - block * BlockSize, encoding);
+}
+
+qint64 LineIndex::lineOffset(qint64 line) const
+{
+    if (line <= 0 || !file) {
+        return line == 0 && file ? encoding.bomLength() : -1;
+    }
+
+    // 第 line 行从第 line - 1 个换行之后开始，先找到它所在的块
+    qint64 n = line - 1;
+    mutex.lock();
+    int block = int(std::upper_bound(blockLines.constBegin(), blockLines.constEnd(), n)
+                    - blockLines.constBegin()) - 1;
+    bool counted = block >= 0 && block + 1 < blockLines.size();
+    qint64 before = counted ? blockLines.at(block) : 0;
+    mutex.unlock();
+
+    if (!counted) {
+        return -1;
+    }
+
+    qint64 start = block * BlockSize;
+    qint64 size = qMin(BlockSize, file->size() - start);
+    qint64 end = findNewline(file->data() + start, size, n - before, encoding);
+    return end == -1 ? -1 : start + end;
+}
+
+// 统计换行数：每次比较 16 个字节（SSE2），没有 SSE2 时用 memchr 逐个跳到换行
+qint64 LineIndex::countNewlines(const char *data, qint64 size, const FileEncoding &encoding)
+{
+    qint64 count = 0;
+
+    if (encoding.unitSize() == 2) {
+        const uchar *p = reinterpret_cast<const uchar *>(data);
+        int lf = encoding.isBigEndian() ? 1 : 0;
+        for (qint64 i = 0; i + 1 < size; i += 2) {
+            count += p[i + lf] == '\n' && p[i + 1 - lf] == 0;
+        }
+        return count;
+    }
+
+    qint64 i = 0;
+#ifdef LINEINDEX_SSE2
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        count += qPopulationCount(uint(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf))));
+    }
+    for (; i < size; ++i) {
+        count += data[i] == '\n';
+    }
+#else
+    while (i < size) {
+        const void *p = memchr(data + i, '\n', size_t(size - i));
+        if (!p) {
+            break;
+        }
+        ++count;
+        i = static_cast<const char *>(p) - data + 1;
+    }
+#endif
+    return count;
+}
+
+qint64 LineIndex::findNewline(const char *data, qint64 size, qint64 n, const FileEncoding &encoding)
+{
+    if (encoding.unitSize() == 2) {
+        const uchar *p = reinterpret_cast<const uchar *>(data);
+        int lf = encoding.isBigEndian() ? 1 : 0;
+        for (qint64 i = 0; i + 1 < size; i += 2) {
+            if (p[i + lf] == '\n' && p[i + 1 - lf] == 0 && n-- == 0) {
+                return i + 2;
+            }
+        }
+        return -1;
+    }
+
+    qint64 i = 0;
+#ifdef LINEINDEX_SSE2
+    // 整组跳过换行数不足的 16 个字节，换行落在这一组时再找出第 n 个置位
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        uint mask = uint(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf)));
+        uint bits = qPopulationCount(mask);
+        if (n < bits) {
+            while (n-- > 0) {
+                mask &= mask - 1;
+            }
+            return i + qCountTrailingZeroBits(mask) + 1;
+        }
+        n -= bits;
+    }
+#endif
+    while (i < size) {
+        const void *p = memchr(data + i, '\n', size_t(size - i));
+        if (!p) {
+            break;
+        }
+        i = static_cast<const char *>(p) - data + 1;
+        if (n-- == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LineIndex::run()
+{
+    const char *data = file->data();
+    qint64 size = file->size();
+    qint64 lines = 0;
+    int blocks = 0;
+
+    mutex.lock();
+    blockLines << 0;
+    mutex.unlock();
+
+    for (qint64 pos = 0; pos < size; pos += BlockSize) {
+        if (stopped.load()) {
+            return;
+        }
+
+        lines += countNewlines(data + pos, qMin(BlockSize, size - pos), encoding);
+
+        mutex.lock();
+        blockLines << lines;
+        mutex.unlock();
+
+        if (++blocks % ReportBlocks == 0) {
+            emit progress();
+        }
+    }
+
+    mutex.lock();
+    finished = true;
+    mutex.unlock();
+    emit progress();
+}
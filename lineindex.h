@@ -0,0 +1,53 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include "mappedfile.h"
+#include "encoding.h"
+
+// 换行索引：在后台按块统计映射文件中的换行数，统计到的部分可以由行号直接求出行首的字节偏移，
+// 或由字节偏移求出行号，每次只需在一块之内扫描。
+// 索引针对的是磁盘上的文件，不随编辑更新：只读的大文件视图一直使用它；普通标签页只在载入完成前
+// 使用（跳到尚未载入的行、显示总行数），载入后改用文档自身的块（findBlockByNumber 按块数二分，
+// blockCount 直接可得），索引随即释放
+class LineIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LineIndex(QObject *parent = 0);
+    ~LineIndex();
+
+    void build(const QSharedPointer<MappedFile> &file, const FileEncoding &encoding); //在后台统计整个文件
+    void clear();   //停止统计并释放映射
+    bool isFinished() const;
+    qint64 lineCount() const;   //文件的总行数，尚未统计完时为 -1
+    qint64 lineAt(qint64 offset) const; //offset 所在行的行号（从 0 开始），尚未统计到时为 -1
+    qint64 lineOffset(qint64 line) const;   //第 line 行（从 0 开始）的行首，尚未统计到或超出范围时为 -1
+
+    static qint64 countNewlines(const char *data, qint64 size, const FileEncoding &encoding);
+    static qint64 findNewline(const char *data, qint64 size, qint64 n,
+                              const FileEncoding &encoding); //第 n 个（从 0 开始）换行之后的偏移，不足时为 -1
+
+signals:
+    void progress();    //统计有了进展（在工作线程中发出）
+
+private:
+    void run();     //工作线程
+
+    QSharedPointer<MappedFile> file;
+    FileEncoding encoding;
+    QFuture<void> future;
+    QAtomicInt stopped;
+    mutable QMutex mutex;   //保护以下成员
+    QVector<qint64> blockLines; //每块之前的换行数，最后一项是已统计部分的换行数
+    bool finished;
+};
+
+#endif // LINEINDEX_H
@@ -0,0 +1,197 @@
+#include <QtAlgorithms>
+#include <string.h>
+
+#include "literalmatcher.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LITERALMATCHER_SSE2
+#endif
+
+static const int HorspoolLength = 16;   // 不短于这个长度的字符串用 Horspool 查找
+
+static inline ushort foldAscii(ushort c)
+{
+    return ushort(c - 'A') < 26 ? c | 0x20 : c;
+}
+
+#ifdef LITERALMATCHER_SSE2
+// 8 个字符中的 A-Z 折叠成小写：c - 'A' 在 [0, 26) 内的加上 0x20
+static inline __m128i foldAscii(__m128i v)
+{
+    __m128i t = _mm_sub_epi16(v, _mm_set1_epi16('A'));
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(t, _mm_set1_epi16(-1)),
+                                  _mm_cmpgt_epi16(_mm_set1_epi16(26), t));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+}
+
+// 以 p 开始的 8 个位置中，首、尾字符都相同的位置（每个位置占两位）
+static inline int candidates(const ushort *p, int m, __m128i first, __m128i last, bool fold)
+{
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + m - 1));
+    if (fold) {
+        a = foldAscii(a);
+        b = foldAscii(b);
+    }
+    return _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(a, first), _mm_cmpeq_epi16(b, last)));
+}
+#endif
+
+LiteralMatcher::LiteralMatcher(const QString &str, Qt::CaseSensitivity cs)
+    : needle(str), folded(str), foldCase(cs == Qt::CaseInsensitive), unicode(false)
+{
+    int m = needle.size();
+    if (foldCase) {
+        for (int i = 0; i < m; ++i) {
+            QChar c = needle.at(i);
+            if (c.unicode() >= 0x80 && c.toLower() != c.toUpper()) {
+                unicode = true;
+            }
+            folded[i] = QChar(foldAscii(c.unicode()));
+        }
+    }
+
+    // 与多个字符低 8 位相同的位置取最小的距离，跳过时不会越过匹配
+    const ushort *f = reinterpret_cast<const ushort *>(folded.constData());
+    for (int c = 0; c < 256; ++c) {
+        skip[c] = m;
+        skipBack[c] = m;
+    }
+    for (int i = 0; i + 1 < m; ++i) {
+        skip[f[i] & 0xFF] = m - 1 - i;
+    }
+    for (int i = m - 1; i > 0; --i) {
+        skipBack[f[i] & 0xFF] = i;
+    }
+}
+
+bool LiteralMatcher::matchesAt(const ushort *p) const
+{
+    const ushort *f = reinterpret_cast<const ushort *>(folded.constData());
+    int m = folded.size();
+    if (!foldCase) {
+        return memcmp(p, f, m * sizeof(ushort)) == 0;
+    }
+    for (int i = 0; i < m; ++i) {
+        if (foldAscii(p[i]) != f[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int LiteralMatcher::indexIn(const QChar *text, int length, int from) const
+{
+    int m = needle.size();
+    from = qMax(0, from);
+    if (m == 0) {
+        return from <= length ? from : -1;
+    }
+    if (unicode) {
+        return QString::fromRawData(text, length).indexOf(needle, from, Qt::CaseInsensitive);
+    }
+
+    const ushort *p = reinterpret_cast<const ushort *>(text);
+    int last = length - m;  // 最后一个可能的起点
+    if (from > last) {
+        return -1;
+    }
+    if (m >= HorspoolLength) {
+        return horspool(p, from, last);
+    }
+
+    const ushort *f = reinterpret_cast<const ushort *>(folded.constData());
+    int i = from;
+#ifdef LITERALMATCHER_SSE2
+    __m128i first = _mm_set1_epi16(short(f[0]));
+    __m128i lastChar = _mm_set1_epi16(short(f[m - 1]));
+    for (; i + 7 <= last; i += 8) {
+        int mask = candidates(p + i, m, first, lastChar, foldCase);
+        while (mask) {
+            int lane = qCountTrailingZeroBits(quint32(mask)) / 2;
+            if (matchesAt(p + i + lane)) {
+                return i + lane;
+            }
+            mask &= ~(3 << (lane * 2));
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if ((foldCase ? foldAscii(p[i]) : p[i]) == f[0] && matchesAt(p + i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int LiteralMatcher::lastIndexIn(const QChar *text, int length, int from) const
+{
+    int m = needle.size();
+    if (m == 0) {
+        return from >= 0 ? qMin(from, length) : -1;
+    }
+    if (unicode) {
+        return from >= 0 ? QString::fromRawData(text, length).lastIndexOf(needle, from, Qt::CaseInsensitive) : -1;
+    }
+
+    const ushort *p = reinterpret_cast<const ushort *>(text);
+    int i = qMin(from, length - m);   // 从这个起点向前
+    if (i < 0) {
+        return -1;
+    }
+    if (m >= HorspoolLength) {
+        return lastHorspool(p, i);
+    }
+
+    const ushort *f = reinterpret_cast<const ushort *>(folded.constData());
+#ifdef LITERALMATCHER_SSE2
+    __m128i first = _mm_set1_epi16(short(f[0]));
+    __m128i lastChar = _mm_set1_epi16(short(f[m - 1]));
+    for (; i >= 7; i -= 8) {
+        int mask = candidates(p + i - 7, m, first, lastChar, foldCase);
+        while (mask) {
+            int lane = (31 - qCountLeadingZeroBits(quint32(mask))) / 2;
+            if (matchesAt(p + i - 7 + lane)) {
+                return i - 7 + lane;
+            }
+            mask &= ~(3 << (lane * 2));
+        }
+    }
+#endif
+    for (; i >= 0; --i) {
+        if ((foldCase ? foldAscii(p[i]) : p[i]) == f[0] && matchesAt(p + i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 按窗口最后一个字符跳过
+int LiteralMatcher::horspool(const ushort *p, int from, int last) const
+{
+    const ushort *f = reinterpret_cast<const ushort *>(folded.constData());
+    int m = folded.size();
+    for (int i = from; i <= last; ) {
+        ushort c = foldCase ? foldAscii(p[i + m - 1]) : p[i + m - 1];
+        if (c == f[m - 1] && matchesAt(p + i)) {
+            return i;
+        }
+        i += skip[c & 0xFF];
+    }
+    return -1;
+}
+
+// 按窗口第一个字符向前跳过
+int LiteralMatcher::lastHorspool(const ushort *p, int from) const
+{
+    const ushort *f = reinterpret_cast<const ushort *>(folded.constData());
+    for (int i = from; i >= 0; ) {
+        ushort c = foldCase ? foldAscii(p[i]) : p[i];
+        if (c == f[0] && matchesAt(p + i)) {
+            return i;
+        }
+        i -= skipBack[c & 0xFF];
+    }
+    return -1;
+}
@@ -0,0 +1,31 @@
+#ifndef LITERALMATCHER_H
+#define LITERALMATCHER_H
+
+#include <QString>
+
+// 在连续的 UTF-16 文本中查找字符串：短的字符串每次比较 8 个字符的首、尾字符（SSE2）筛出候选位置，
+// 长的字符串用 Boyer-Moore-Horspool 跳过；不区分大小写时按 ASCII 折叠（也是向量化的），
+// 含有非 ASCII 大小写字母的字符串交给 QString 按 Unicode 比较
+class LiteralMatcher
+{
+public:
+    LiteralMatcher(const QString &str, Qt::CaseSensitivity cs);
+
+    int indexIn(const QChar *text, int length, int from) const;     //from 之后（含）的第一个匹配，没有时返回 -1
+    int lastIndexIn(const QChar *text, int length, int from) const; //起点不超过 from 的最后一个匹配，没有时返回 -1
+    int size() const { return needle.size(); }
+
+private:
+    bool matchesAt(const ushort *p) const;  //p 处是否匹配（文本按需折叠）
+    int horspool(const ushort *p, int from, int last) const;
+    int lastHorspool(const ushort *p, int from) const;
+
+    QString needle;
+    QString folded;     //折叠成小写的 needle（区分大小写时与 needle 相同）
+    bool foldCase;
+    bool unicode;       //需要按 Unicode 比较大小写
+    int skip[256];      //向前查找时，按窗口最后一个字符（低 8 位）跳过的距离
+    int skipBack[256];  //向后查找时，按窗口第一个字符跳过的距离
+};
+
+#endif // LITERALMATCHER_H
@@ -6,7 +6,6 @@
 #include <QPrinter>
 #include <QPrintPreviewDialog>
 #include <QTabWidget>
-#include <QTextDocumentWriter>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QKeySequence>
@@ -22,10 +21,21 @@
 #include <QMimeData>
 #include <QCoreApplication>
 #include <QApplication>
+#include <QTabBar>
+#include <QProgressBar>
+#include <QTimer>
+#include <QInputDialog>
+
+#include <limits>
 
 #include "mainwindow.h"
 #include "notepad.h"
+#include "largefileview.h"
 #include "searchdialog.h"
+#include "fileloader.h"
+
+static const int PrefetchInterval = 1000;   // 空闲时载入下一个占位标签页的间隔（毫秒）
+static const qint64 MaxDocumentSize = 256 * 1024 * 1024;  // 可编辑的标签页会把整个文件解码进文档，更大的文件总是只读分段显示
 
 MainWindow::MainWindow(Config *config,QWidget *parent)
     : QMainWindow(parent), config(config)
@@ -68,6 +78,19 @@ void MainWindow::init()
 
     searchDialog = new SearchDialog(config);
     searchDialog->setVisible(false);
+    connect(searchDialog, SIGNAL(findInFiles(QString, bool, bool, QString, QStringList)),
+            this, SLOT(findInFiles(QString, bool, bool, QString, QStringList)));
+
+    findInFilesPanel = new FindInFilesPanel(this);
+    addDockWidget(Qt::BottomDockWidgetArea, findInFilesPanel);
+    findInFilesPanel->hide();
+    connect(findInFilesPanel, SIGNAL(matchActivated(QString, qint64, int, int)),
+            this, SLOT(showFileMatch(QString, qint64, int, int)));
+
+    // 空闲时逐个载入恢复会话时创建的占位标签页
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setInterval(PrefetchInterval);
+    connect(prefetchTimer, SIGNAL(timeout()), this, SLOT(prefetchPlaceholder()));
 }
 
 void MainWindow::saveWindow()
@@ -102,6 +125,8 @@ bool MainWindow::maybeSave(int index)
 {
     NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(index));
     QString fileName = openedFiles.at(index);
+    if (notePad->isSaving() && notePad->waitForSaved())   // 等待后台保存结束
+        return true;
     if (!notePad->document()->isModified())      // 自定义一个警告对话框
         return true;
     if (fileName.startsWith(QLatin1String(":/"))) // startsWith判断该文件名是否是以什么开头的
@@ -112,7 +137,7 @@ bool MainWindow::maybeSave(int index)
                                   "Do you want to save your changes?"),
                                QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);//文档已被修改
     if (ret == QMessageBox::Save)
-        return fileSave(index);
+        return fileSave(index) && notePad->waitForSaved();
     else if (ret == QMessageBox::Cancel)
         return false;
     return true;
@@ -129,23 +154,32 @@ void MainWindow::currentChanged(int index)
             if (!config->recentFiles.length()) {
                 newFile();
             } else {
+                // 先只创建占位标签页，切换到它或空闲时才载入，启动时只载入当前的一个文件
                 QStringListIterator it(config->recentFiles);
                 bool fileExists = false;
                 while (it.hasNext()) {
                     QString fileName = it.next();
-                    if (QFileInfo(fileName).exists()) {
-                        openFile(fileName);
+                    if (QFileInfo(fileName).exists() && !openedFiles.contains(fileName)) {
+                        newPlaceholderTab(fileName);
                         fileExists = true;
                     }
                 }
                 if (!fileExists) {
                     newFile();
+                } else {
+                    tabWidget->setCurrentIndex(tabWidget->count() - 1);
+                    prefetchTimer->start();
                 }
             }
         }
         //updateTextStyleActs(config->fontStyle);
         return;
     }
+    // 延迟到事件循环空闲时再载入，连续切换或关闭标签页时只载入最后停留的那一个
+    if (EDITOR->isPlaceholder())
+        QTimer::singleShot(0, this, SLOT(loadCurrentPlaceholder()));
+    // 查找对话框不是模态的，切换标签页后边输入边查找、全部查找都应在新的当前标签页中进行
+    searchDialog->setEditor(EDITOR);
     updateActions();
     setWindowIcon(QIcon(tr(":images/notepad.png")));
     setWindowTitle(tr("Q-Text-Editor (%1)").arg(openedFiles.at(index)));
@@ -154,15 +188,18 @@ void MainWindow::currentChanged(int index)
 // 文档发生改变
 void MainWindow::modificationChanged(bool changed)
 {
-    QString str = tabWidget->tabText(tabWidget->currentIndex());
+    // 后台载入、保存的文档不一定是当前标签页
+    int index = tabWidget->indexOf(static_cast<QWidget *>(sender()));
+    if (index == -1)
+        index = tabWidget->currentIndex();
+    QString str = tabWidget->tabText(index);
     if (str[str.length() - 1] == '*') {
         if (!changed)
             str.resize(str.length() - 1);
     } else if (changed) {
         str += '*';
     }
-    qDebug() << ">>> modificationChanged " << str;
-    tabWidget->setTabText(tabWidget->currentIndex(), str);
+    tabWidget->setTabText(index, str);
     refreshActions();
     setupEditActions();
 }
@@ -194,6 +231,8 @@ void MainWindow::refreshActions()
     if (const QMimeData *md = QApplication::clipboard()->mimeData())
         pasteAct->setEnabled(md->hasText());
 #endif
+    cancelLoadAct->setEnabled(EDITOR->isLoading());
+    followAct->setChecked(EDITOR->isFollowing());
     nextAct->setEnabled(tabWidget->currentIndex()<tabWidget->count()-1);
     previousAct->setEnabled(tabWidget->currentIndex()>=1);
 }
@@ -212,6 +251,8 @@ void MainWindow::closeEvent(QCloseEvent *event)
 {
     for (int i = 0; i < tabWidget->count(); i++)
     {
+        if (static_cast<NotePad*>(tabWidget->widget(i))->isPlaceholder())
+            continue;   // 尚未载入，不会有修改
         tabWidget->setCurrentIndex(i);
         if (!maybeSave(i))
         {
@@ -219,17 +260,35 @@ void MainWindow::closeEvent(QCloseEvent *event)
             return;
         }
     }
+    saveViewStates();
     event->accept();
 }
 
+// 记下各文件的光标和滚动位置，下次启动恢复会话时使用
+void MainWindow::saveViewStates()
+{
+    QVariantMap states;
+    for (int i = 0; i < tabWidget->count(); i++) {
+        QString fileName = openedFiles.at(i);
+        if (!config->recentFiles.contains(fileName))
+            continue;
+        QVariantList state = static_cast<NotePad*>(tabWidget->widget(i))->viewState();
+        if (!state.isEmpty())
+            states.insert(fileName, state);
+    }
+    config->fileStates = states;
+}
+
 //关闭已经重复打开的文件 1
 void MainWindow::closeDuplicate(int index)
 {
     QString fileName = openedFiles.at(index);
     for (int i = 0; i < openedFiles.count(); i++) {
         if (openedFiles.at(i) == fileName && i != index) {
+            QWidget *widget = tabWidget->widget(i);
             openedFiles.removeAt(i);
             tabWidget->removeTab(i); // 去掉编号为i的tab
+            widget->deleteLater();
         }
     }
     int currIndex = openedFiles.indexOf(fileName); // 获得精准匹配的该位置的索引值
@@ -238,15 +297,207 @@ void MainWindow::closeDuplicate(int index)
 }
 
 //创建新的Tab（用于打开文件）1
-void MainWindow::newTab(const QString& fileName, QFile& file)
+void MainWindow::newTab(const QString& fileName)
+{
+    if (isLargeFile(fileName)) {
+        NotePad *view = openLargeFile(fileName);
+        if (view)
+            tabWidget->setCurrentWidget(view);
+        return;
+    }
+
+    // 以内存映射方式打开文件，只解码首屏内容，其余部分随滚动按需解码
+    FileLoader *loader = new FileLoader(fileName);
+    if (!loader->open()) {
+        delete loader;
+        return;
+    }
+
+    NotePad *notePad = addNotePad(fileName);
+    notePad->loadFile(loader);
+    tabWidget->setCurrentWidget(notePad);
+}
+
+// 创建占位的Tab：只记下文件名和上次的光标、滚动位置，切换到它或空闲时才载入
+void MainWindow::newPlaceholderTab(const QString &fileName)
+{
+    if (isLargeFile(fileName)) {
+        openLargeFile(fileName); // 只做映射，不需要占位
+        return;
+    }
+
+    NotePad *notePad = addNotePad(fileName);
+    notePad->setPlaceholder(true);
+    notePad->restoreViewState(config->fileStates.value(fileName).toList());
+}
+
+// 超过设定大小的文件以只读方式分段显示，不整个载入文档
+bool MainWindow::isLargeFile(const QString &fileName) const
+{
+    qint64 threshold = qint64(config->largeFileSize) * 1024 * 1024;
+    if (threshold <= 0 || threshold > MaxDocumentSize)
+        threshold = MaxDocumentSize;    // 设置只能调低，不能超过上限
+    return QFileInfo(fileName).size() > threshold;
+}
+
+NotePad *MainWindow::openLargeFile(const QString &fileName)
+{
+    LargeFileView *view = new LargeFileView;
+    if (!view->openFile(fileName)) {
+        delete view;
+        return 0;
+    }
+    return addNotePad(fileName, view);
+}
+
+NotePad *MainWindow::addNotePad(const QString &fileName, NotePad *notePad)
 {
     openedFiles << fileName;//将该文件名加入文件列表中
-    NotePad *notePad = new NotePad;
+    if (!notePad)
+        notePad = new NotePad;
+    notePad->setLanguage(LanguageRegistry::languageForFile(fileName));
     tabWidget->addTab(notePad, QFileInfo(fileName).fileName());//QTabWidget，addTab 的作用是将notePad 添加到tab中去
-    QByteArray data = file.readAll();
-    QTextCodec* codec = QTextCodec::codecForName("utf-8");
-    notePad->setPlainText(codec->toUnicode(data));  // 文本内容为这个
-    tabWidget->setCurrentWidget(notePad);
+    connect(notePad, SIGNAL(progress(int)), this, SLOT(updateProgress(int)));
+    connect(notePad, SIGNAL(loadFinished()), this, SLOT(loadFinished()));
+    return notePad;
+}
+
+// 载入占位标签页对应的文件
+void MainWindow::loadPlaceholder(int index)
+{
+    NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(index));
+    if (!notePad->isPlaceholder())
+        return;
+
+    FileLoader *loader = new FileLoader(openedFiles.at(index));
+    if (!loader->open()) {
+        delete loader;
+        return;
+    }
+
+    notePad->setPlaceholder(false);
+    notePad->loadFile(loader);
+    if (index == tabWidget->currentIndex())
+        refreshActions();
+}
+
+void MainWindow::loadCurrentPlaceholder()
+{
+    if (tabWidget->count())
+        loadPlaceholder(tabWidget->currentIndex());
+}
+
+// 没有文件正在载入时，在后台载入下一个占位标签页
+void MainWindow::prefetchPlaceholder()
+{
+    int next = -1;
+    for (int i = 0; i < tabWidget->count(); i++) {
+        NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(i));
+        if (notePad->isLoading())
+            return;
+        if (next == -1 && notePad->isPlaceholder())
+            next = i;
+    }
+
+    if (next == -1)
+        prefetchTimer->stop();
+    else
+        loadPlaceholder(next);
+}
+
+//在标签上显示后台载入、保存的进度
+void MainWindow::updateProgress(int percent)
+{
+    int index = tabWidget->indexOf(static_cast<QWidget *>(sender()));
+    if (index == -1)
+        return;
+
+    QProgressBar *progress = static_cast<QProgressBar *>(
+                tabWidget->tabBar()->tabButton(index, QTabBar::LeftSide));
+    if (!progress) {
+        if (percent >= 100)
+            return; // 很快就完成的操作不显示进度条
+        progress = new QProgressBar;
+        progress->setRange(0, 100);
+        progress->setTextVisible(false);
+        progress->setFixedSize(40, 10);
+        tabWidget->tabBar()->setTabButton(index, QTabBar::LeftSide, progress);
+    }
+    progress->setValue(percent);
+}
+
+//去掉标签上的进度条
+void MainWindow::hideProgress(int index)
+{
+    QWidget *progress = tabWidget->tabBar()->tabButton(index, QTabBar::LeftSide);
+    tabWidget->tabBar()->setTabButton(index, QTabBar::LeftSide, 0);
+    if (progress)
+        progress->deleteLater();
+}
+
+//文件已在后台载入完毕
+void MainWindow::loadFinished()
+{
+    int index = tabWidget->indexOf(static_cast<QWidget *>(sender()));
+    if (index == -1)
+        return;
+
+    hideProgress(index);
+    if (index == tabWidget->currentIndex())
+        refreshActions();
+}
+
+//后台保存结束，成功时文档的修改标记已由 modificationChanged 更新
+void MainWindow::saveFinished(bool success, const QString &error)
+{
+    NotePad *notePad = static_cast<NotePad *>(sender());
+    int index = tabWidget->indexOf(notePad);
+    if (index != -1)
+        hideProgress(index);
+
+    QString fileName = index != -1 ? openedFiles.at(index) : QString();
+    // “全部保存”中的文档：记下结果，全部结束后一起报告
+    savingAll.removeAll(QPointer<NotePad>());   // 保存期间被关闭的文档
+    if (savingAll.removeOne(notePad)) {
+        if (!success)
+            saveAllErrors << tr("%1: %2").arg(fileName).arg(error);
+        if (savingAll.isEmpty() && !saveAllErrors.isEmpty()) {
+            QMessageBox::warning(this, tr("Warning"),
+                                 tr("Cannot save %n file(s):\n%1", 0, saveAllErrors.count())
+                                 .arg(saveAllErrors.join(QLatin1Char('\n'))));
+            saveAllErrors.clear();
+        }
+        return;
+    }
+
+    if (!success) {
+        QMessageBox::warning(this, tr("Warning"),
+                             tr("Cannot save file %1:\n%2").arg(fileName).arg(error));
+    }
+}
+
+//放弃载入当前文件（关闭该标签页）
+void MainWindow::cancelLoading()
+{
+    if (EDITOR->isLoading())
+        fileClose(tabWidget->currentIndex());
+}
+//跟踪当前文件末尾（查看正在写入的日志）
+void MainWindow::followTail(bool on)
+{
+    int index = tabWidget->currentIndex();
+    loadPlaceholder(index);
+    if (on && !maybeSave(index)) {
+        followAct->setChecked(false);
+        return;
+    }
+
+    if (!EDITOR->setFollowing(on)) {
+        followAct->setChecked(false);
+        QMessageBox::warning(this, tr("Warning"),
+                             tr("Only saved, unmodified files can be followed."));
+    }
+    refreshActions();
 }
 //文件菜单功能实现
 void MainWindow::setupFileMenu()
@@ -300,6 +551,16 @@ void MainWindow::setupFileMenu()
     fileMenu->addAction(closeAllAct);
     topToolBar->addAction(closeAllAct);
 
+    //放弃载入
+    cancelLoadAct = new QAction(tr("Cancel Loading"), this);
+    cancelLoadAct->setEnabled(false);
+    fileMenu->addAction(cancelLoadAct);
+
+    //跟踪文件末尾
+    followAct = new QAction(tr("&Follow Tail"), this);
+    followAct->setCheckable(true);
+    fileMenu->addAction(followAct);
+
     topToolBar->addSeparator();
 
     menuBar->addMenu(fileMenu);
@@ -313,10 +574,12 @@ void MainWindow::setupFileActions()
     connect(newAct, SIGNAL(triggered()), this, SLOT(newFile()));
     connect(saveAct, SIGNAL(triggered()), this, SLOT(fileSave()));
     connect(saveAsAct, SIGNAL(triggered()), this, SLOT(fileSaveAs()));
-    connect(saveAllAct, SIGNAL(triggered()), this, SLOT(fileSaveAll()));
+    connect(saveAllAct, SIGNAL(triggered()), this, SLOT(fileSaveAllInBackground()));
 
     connect(closeAct, SIGNAL(triggered()), this, SLOT(fileClose()));
     connect(closeAllAct, SIGNAL(triggered()), this, SLOT(fileCloseAll()));
+    connect(cancelLoadAct, SIGNAL(triggered()), this, SLOT(cancelLoading()));
+    connect(followAct, SIGNAL(triggered(bool)), this, SLOT(followTail(bool)));
 }
 //打开文件 1
 void MainWindow::openFile()
@@ -332,13 +595,9 @@ void MainWindow::openFile()
             fileName = files.at(i);
             if (QFile::exists(fileName))//判断文件是否存在
             {
-                QFile file(fileName);
-                if (file.open(QFile::ReadOnly))
-                {
-                    if (openedFiles.contains(fileName))
-                        continue;
-                    newTab(fileName, file);
-                }
+                if (openedFiles.contains(fileName))
+                    continue;
+                newTab(fileName);
             }
         }
     }
@@ -350,9 +609,7 @@ void MainWindow::openFile(QString fileName)
     if (index != -1) {
         tabWidget->setCurrentIndex(index);
     } else {
-        QFile file(fileName);
-        if (file.open(QFile::ReadOnly))
-            newTab(fileName, file);
+        newTab(fileName);
     }
 }
 //新建文件 1
@@ -373,35 +630,38 @@ bool MainWindow::fileSaveAs(int index)
 
     openedFiles.replace(index, fn);//替换函数
     tabWidget->setTabText(index, QFileInfo(fn).fileName());
+    static_cast<NotePad *>(tabWidget->widget(index))->setLanguage(LanguageRegistry::languageForFile(fn));
     return fileSave(index);
 }
 
 //保存文件 1
 bool MainWindow::fileSave(int index)
 {
-    NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(index));
     QString fileName = openedFiles.at(index);
 
     if (!fileName.contains("/") && !fileName.contains("\\"))
         return fileSaveAs(index);
 
-    // 若要编写文档，请使用文件名或设备对象构造 QTextDocumentWriter 对象
-    QTextDocumentWriter writer(fileName);
-    writer.setFormat("plaintext");
-    // 将给定的文档写入分配的设备或文件，如果成功，则返回1;否则返回0.
-    bool success = writer.write(notePad->document());
-    if (success) {
-        notePad->document()->setModified(false); // setModified不可编辑功能
-        tabWidget->setCurrentWidget(notePad);    // 获取当前页面
+    bool success = saveInBackground(index);
+    if (success && index == tabWidget->currentIndex())
         setWindowTitle(tr("Q-Text-Editor (%1)").arg(fileName));
-    } else {
-        qDebug() << "fileSave error: " << fileName;
-    }
 
     closeDuplicate(index);
     return success;
 }
 
+// 取文档的快照在线程池中写入临时文件，完成后原子地替换原文件，结果由 saveFinished 返回
+bool MainWindow::saveInBackground(int index)
+{
+    NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(index));
+
+    connect(notePad, SIGNAL(progress(int)), this, SLOT(updateProgress(int)),
+            Qt::UniqueConnection);
+    connect(notePad, SIGNAL(saveFinished(bool,QString)), this,
+            SLOT(saveFinished(bool,QString)), Qt::UniqueConnection);
+    return notePad->saveFile(openedFiles.at(index));
+}
+
 //文件另存为（保存当前文件）1
 bool MainWindow::fileSaveAs()
 {
@@ -415,21 +675,50 @@ bool MainWindow::fileSave()
 }
 
 //保存所有文件 1
-bool MainWindow::fileSaveAll()
+// 只是开始保存：返回时数据不一定已写入磁盘。关闭文件和退出都经过 maybeSave()，它会等待后台保存结束
+// 已命名且被修改过的文档同时在后台保存，不切换标签页，全部结束后统一报告失败的文件；
+// 未命名的文档随后逐个询问文件名
+bool MainWindow::fileSaveAllInBackground()
 {
     bool success = true;
+    QList<NotePad *> untitled;
+
     for (int i = 0; i < tabWidget->count(); i++)
     {
-        tabWidget->setCurrentIndex(i);
-        success = fileSave(i);
+        NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(i));
+        QString fileName = openedFiles.at(i);
+
+        if (!notePad->document()->isModified() || fileName.startsWith(QLatin1String(":/")))
+            continue;
+
+        if (!fileName.contains("/") && !fileName.contains("\\")) {
+            untitled << notePad;
+            continue;
+        }
+
+        if (!saveInBackground(i))
+            success = false;
+        else if (!savingAll.contains(notePad))
+            savingAll << notePad;
+    }
+
+    foreach (NotePad *notePad, untitled) {
+        int index = tabWidget->indexOf(notePad);
+        if (index == -1)
+            continue;
+        tabWidget->setCurrentIndex(index);
+        success = fileSaveAs(index) && success;
     }
     return success;
 }
 
 //关闭文件（指定文件）1
+// removeTab() 只把编辑器从标签页中拿下来，还要删除它：大文件视图删除时才停下后台统计并解除映射
 void MainWindow::fileClose(int index)
 {
     if (maybeSave(index)) {
+        NotePad *notePad = static_cast<NotePad*>(tabWidget->widget(index));
+        notePad->cancelLoading();
         if (openedFiles.count() == 1) {
             newFile();
             config->recentFiles.removeAll(openedFiles.at(0));
@@ -440,6 +729,7 @@ void MainWindow::fileClose(int index)
             openedFiles.removeAt(index);
             tabWidget->removeTab(index);
         }
+        notePad->deleteLater();
     }
 }
 
@@ -456,17 +746,21 @@ void MainWindow::fileCloseAll()
     {
         if (maybeSave(tabWidget->currentIndex()))
         {
+            NotePad *notePad = EDITOR;
+            notePad->cancelLoading();
             if (openedFiles.count() == 1)
             {
                 newFile();
                 openedFiles.removeAt(0);
                 tabWidget->removeTab(0);
+                notePad->deleteLater();
                 break;
             }
             else
             {
                 openedFiles.removeAt(tabWidget->currentIndex());
                 tabWidget->removeTab(tabWidget->currentIndex());
+                notePad->deleteLater();
             }
         }
         else
@@ -552,6 +846,15 @@ void MainWindow::setupEditMenu()
     editMenu->addAction(findAct);
     topToolBar->addAction(findAct);
 
+    //在文件中查找
+    findInFilesAct = new QAction(tr("Find in F&iles..."), this);
+    findInFilesAct->setShortcut(Qt::CTRL + Qt::SHIFT + Qt::Key_F);
+    editMenu->addAction(findInFilesAct);
+
+    //跳转到行
+    goToLineAct = new QAction(tr("&Go to Line..."), this);
+    goToLineAct->setShortcut(Qt::CTRL + Qt::Key_G);
+    editMenu->addAction(goToLineAct);
 
     editMenu->addSeparator();
 
@@ -561,12 +864,15 @@ void MainWindow::setupEditMenu()
 //编辑菜单Action设置 1
 void MainWindow::setupEditActions()
 {
-    connect(copyAct, SIGNAL(triggered()), EDITOR,SLOT(copy()));
-    connect(pasteAct,SIGNAL(triggered()),EDITOR,SLOT(paste()));
-    connect(undoAct,SIGNAL(triggered()),EDITOR,SLOT(undo()));
-    connect(redoAct,SIGNAL(triggered()),EDITOR,SLOT(redo()));
-    connect(selectAllAct,SIGNAL(triggered()),EDITOR,SLOT(selectAll()));
-    connect(findAct,SIGNAL(triggered()),this,SLOT(search()));
+    // 每次文档修改状态变化都会调用，避免重复连接
+    connect(copyAct, SIGNAL(triggered()), EDITOR,SLOT(copy()), Qt::UniqueConnection);
+    connect(pasteAct,SIGNAL(triggered()),EDITOR,SLOT(paste()), Qt::UniqueConnection);
+    connect(undoAct,SIGNAL(triggered()),EDITOR,SLOT(undo()), Qt::UniqueConnection);
+    connect(redoAct,SIGNAL(triggered()),EDITOR,SLOT(redo()), Qt::UniqueConnection);
+    connect(selectAllAct,SIGNAL(triggered()),EDITOR,SLOT(selectAll()), Qt::UniqueConnection);
+    connect(findAct,SIGNAL(triggered()),this,SLOT(search()), Qt::UniqueConnection);
+    connect(findInFilesAct,SIGNAL(triggered()),this,SLOT(search()), Qt::UniqueConnection);
+    connect(goToLineAct,SIGNAL(triggered()),this,SLOT(goToLine()), Qt::UniqueConnection);
 
 }
 //下一个窗口 1
@@ -679,6 +985,9 @@ void MainWindow::setupWindowMenu()
     windowMenu->addMenu(currentAllMenu);
     openedFilesGrp = new QActionGroup(this);
 
+    //在文件中查找的结果面板
+    windowMenu->addAction(findInFilesPanel->toggleViewAction());
+
     topToolBar->addSeparator();
     menuBar->addMenu(windowMenu);
     setupWindowActions();
@@ -755,11 +1064,23 @@ void MainWindow::showReadme()
                 << "===========================================================================*/";
         file.close();
     }
-    QFile rfile(readmeFile);
-    rfile.open(QFile::ReadOnly);
-    newTab(readmeFile, rfile);
+    newTab(readmeFile);
 }
 //查找
+//跳转到行（总行数来自换行索引，文件尚未载入完也可以跳转）
+void MainWindow::goToLine()
+{
+    qint64 lines = EDITOR->lineCount();
+    bool ok;
+    int line = QInputDialog::getInt(this, tr("Go to Line"),
+                                    tr("Line number (1 - %1):").arg(lines),
+                                    int(qMax<qint64>(1, EDITOR->currentLineNumber())), 1,
+                                    int(qMin<qint64>(lines, std::numeric_limits<int>::max())), 1, &ok);
+    if (ok && !EDITOR->goToLine(line))
+        QMessageBox::information(this, tr("Go to Line"),
+                                 tr("Lines are still being counted, please try again later."));
+}
+
 void MainWindow::search()
 {
     int index = tabWidget->currentIndex();
@@ -768,9 +1089,57 @@ void MainWindow::search()
         searchDialog->activateWindow();
     else
         searchDialog->show();
-    connect(searchDialog, SIGNAL(search(QString, bool, bool, bool)),EDITOR,SLOT(search(QString, bool, bool, bool)));
-    connect(searchDialog, SIGNAL(replace(QString, QString, bool, bool, bool)), EDITOR,SLOT(replace(QString, QString, bool, bool, bool)));
-    connect(searchDialog, SIGNAL(replaceAll(QString, QString, bool, bool)),EDITOR,SLOT(replaceAll(QString, QString, bool, bool)));
+    searchDialog->setEditor(EDITOR);
+}
+
+// 在文件中查找：打开的标签页中，未保存的和不在磁盘上的查找编辑器中的内容，其余的读文件
+void MainWindow::findInFiles(QString str, bool matchCase, bool regExp, QString directory, QStringList nameFilters)
+{
+    if (str.isEmpty())
+        return;
+
+    QStringList files;
+    QHash<QString, PieceTable> buffers;
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        NotePad *notePad = static_cast<NotePad *>(tabWidget->widget(i));
+        const QString &fileName = openedFiles.at(i);
+        if (!notePad->isPlaceholder()
+                && (notePad->document()->isModified() || !QFileInfo(fileName).isFile())) {
+            // 片段表只含已载入的部分，先载入剩余内容
+            if (notePad->isLoading())
+                notePad->loadAll();
+            buffers.insert(fileName, notePad->pieceTable());
+        }
+        if (directory.isEmpty())
+            files << fileName;
+    }
+
+    findInFilesPanel->start(files, directory, nameFilters, buffers, str, matchCase, regExp);
+    findInFilesPanel->show();
+    findInFilesPanel->raise();
+}
+
+void MainWindow::showFileMatch(const QString &fileName, qint64 line, int column, int length)
+{
+    openFile(fileName);
+    if (openedFiles.indexOf(fileName) != tabWidget->currentIndex())
+        return;     // 文件打不开
+    if (EDITOR->isPlaceholder())
+        loadCurrentPlaceholder();
+    if (!EDITOR->goToLine(line)) {
+        QMessageBox::information(this, tr("Go to Line"),
+                                 tr("Lines are still being counted, please try again later."));
+        return;
+    }
+
+    // 文件在查找之后被修改过时，列和长度不超出该行
+    QTextCursor cursor = EDITOR->textCursor();
+    int lineLength = cursor.block().length() - 1;
+    column = qBound(0, column, lineLength);
+    cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
+    cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor, qBound(0, length, lineLength - column));
+    EDITOR->setTextCursor(cursor);
+    EDITOR->setFocus();
 }
 
 MainWindow::~MainWindow()
@@ -789,12 +1158,15 @@ MainWindow::~MainWindow()
      delete saveAllAct;     // 保存所有
      delete closeAct;       // 关闭文件
      delete closeAllAct;    // 关闭所有文件
+     delete cancelLoadAct;  // 放弃载入
+     delete followAct;      // 跟踪文件末尾
 
      delete cutAct;        // 剪切
      delete pasteAct;      // 粘贴
      delete undoAct;       // 撤销
      delete redoAct;       // 重做
      delete selectAllAct;  // 全选
+     delete goToLineAct;   // 跳转到行
 
      delete function; // 运行
      delete debug;    // 调试
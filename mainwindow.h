@@ -1,9 +1,11 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 #include <QMainWindow>
+#include <QPointer>
 #include "notepad.h"
 #include "config.h"
 #include "searchdialog.h"
+#include "findinfilespanel.h"
 QT_BEGIN_NAMESPACE
 QT_FORWARD_DECLARE_CLASS(QTabWidget)
 QT_FORWARD_DECLARE_CLASS (QMenuBar)
@@ -14,6 +16,7 @@ QT_FORWARD_DECLARE_CLASS (QFontComboBox)
 QT_FORWARD_DECLARE_CLASS (QActionGroup)
 QT_FORWARD_DECLARE_CLASS (QTextCharFormat)
 QT_FORWARD_DECLARE_CLASS (QPrinter)
+QT_FORWARD_DECLARE_CLASS (QTimer)
 QT_END_NAMESPACE
 
 #define EDITOR   static_cast<NotePad *>(tabWidget->currentWidget())
@@ -43,7 +46,7 @@ public slots:
     bool fileSave(int index);   //保存文件（保存指定文件）1
     bool fileSaveAs();  //文件另存为（保存当前文件）1
     bool fileSave();    //保存文件（保存当前文件）1
-    bool fileSaveAll(); //保存所有文件 1
+    bool fileSaveAllInBackground(); //开始在后台保存所有文件，返回是否都已开始（不表示已写入磁盘，需要时用 NotePad::waitForSaved 等待）
     void fileClose(int index);   //关闭文件（指定文件） 1
     void fileClose();   //关闭文件（当前文件） 1
     void fileCloseAll();    //关闭所有文件 1
@@ -54,17 +57,34 @@ public slots:
     void openRecentFile();  //打开最近的文档 1
     void updateRecentFiles();    //更新最近打开的文件菜单 1
     void search();  //查找
+    void findInFiles(QString str, bool matchCase, bool regExp, QString directory, QStringList nameFilters); //在文件中查找
+    void showFileMatch(const QString &fileName, qint64 line, int column, int length); //打开文件并选中在文件中查找的匹配
+    void goToLine();    //跳转到行
     void about();   //关于本软件 1
+    void cancelLoading();   //放弃载入当前文件
+    void followTail(bool on);   //跟踪当前文件末尾
+    void updateProgress(int percent);   //在标签上显示后台载入、保存的进度
+    void loadFinished();    //文件已在后台载入完毕
+    void saveFinished(bool success, const QString &error);  //后台保存结束
+    void loadCurrentPlaceholder();  //载入当前的占位标签页
+    void prefetchPlaceholder();     //空闲时载入下一个占位标签页
 private:
     void saveWindow();
+    void hideProgress(int index);   //去掉标签上的进度条
+    bool saveInBackground(int index);   //在后台保存指定文件
+    void saveViewStates();  //记下各文件的光标和滚动位置
 
     Config *config;//编辑器
     QTabWidget *tabWidget;//Tab栏
     SearchDialog *searchDialog; //查找/替换框
+    FindInFilesPanel *findInFilesPanel; //在文件中查找的结果
     int newNumber;//新建文件的数目
     QStringList openedFiles;//打开的文件
+    QList<QPointer<NotePad> > savingAll;    //“全部保存”中尚未结束的文档
+    QStringList saveAllErrors;  //“全部保存”中失败的文件
     QList<QAction * > recentFileActs;//最近打开的问文件
     QActionGroup *openedFilesGrp;//文件窗口Action Group
+    QTimer *prefetchTimer;  //空闲时载入占位标签页
 
 
     QMenuBar *menuBar;//菜单栏
@@ -78,6 +98,8 @@ private:
     QAction *saveAllAct;    //保存所有
     QAction *closeAct;  //关闭文件
     QAction *closeAllAct;   //关闭所有文件
+    QAction *cancelLoadAct; //放弃载入
+    QAction *followAct;     //跟踪文件末尾
 
     QMenu *editMenu;    //编辑菜单
     QAction *copyAct;   //复制
@@ -87,6 +109,8 @@ private:
     QAction *redoAct;   //重做
     QAction *selectAllAct;  //全选
     QAction *findAct;   //查找和替换
+    QAction *findInFilesAct;    //在文件中查找
+    QAction *goToLineAct;   //跳转到行
 
     QMenu *compileMenu;//编译菜单
     QAction *function;//运行
@@ -118,7 +142,12 @@ private:
     void setupHelpMenu();   //帮助菜单功能实现
     void setupHelpActions();    //帮助Action设置
 
-    void newTab(const QString& fileName, QFile& file);  //创建新的Tab（用于打开文件）
+    void newTab(const QString& fileName);  //创建新的Tab（用于打开文件）
+    void newPlaceholderTab(const QString &fileName); //创建占位的Tab（用于恢复上次打开的文件）
+    NotePad *addNotePad(const QString &fileName, NotePad *notePad = 0); //添加一个Tab（默认为空的NotePad）
+    bool isLargeFile(const QString &fileName) const; //是否应以只读方式分段显示
+    NotePad *openLargeFile(const QString &fileName); //以只读方式分段显示大文件
+    void loadPlaceholder(int index); //载入占位标签页对应的文件
     bool maybeSave(int index); //判断指定文件是否需要保存
     void closeDuplicate(int index); //关闭已经重复打开的文件
     void updateActions();   //更新各action的状态
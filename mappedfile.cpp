@@ -0,0 +1,46 @@
+#include <QDebug>
+#include <QFileInfo>
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile(const QString &fileName)
+    : file(fileName), mapped(0), bytes(0), length(0), valid(false)
+{
+    if (!file.open(QFile::ReadOnly)) {
+        qDebug() << "Open file " << fileName << "error" << __FUNCTION__;
+        return;
+    }
+
+    length = file.size();
+    modified = QFileInfo(file).lastModified();
+    if (length > 0) {
+        mapped = file.map(0, length);
+    }
+
+    if (mapped) {
+        bytes = reinterpret_cast<const char *>(mapped);
+    } else {
+        // 资源文件或空文件无法映射，退回到普通读取
+        buffer = file.readAll();
+        bytes = buffer.constData();
+        length = buffer.size();
+    }
+    valid = true;
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped) {
+        file.unmap(mapped);
+    }
+}
+
+// 读入后备缓冲的内容已与文件无关，不会变化
+bool MappedFile::isChanged() const
+{
+    if (!mapped) {
+        return false;
+    }
+    QFileInfo info(file.fileName());
+    return info.size() != length || info.lastModified() != modified;
+}
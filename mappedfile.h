@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QDateTime>
+
+// 文件的只读内存映射，可以通过 QSharedPointer 在载入器、文档和快照之间共享。
+// 映射随文件变化：其他程序改写或截断文件后，映射中的内容不再是打开时的内容，
+// 截断后读取超出文件末尾的部分还会使进程崩溃（SIGBUS），使用前先用 isChanged() 检查
+class MappedFile
+{
+public:
+    explicit MappedFile(const QString &fileName);
+    ~MappedFile();
+
+    bool isValid() const { return valid; }
+    QString fileName() const { return file.fileName(); }
+    const char *data() const { return bytes; }
+    qint64 size() const { return length; }
+    bool isChanged() const; //文件的大小或修改时间与映射时不同
+
+private:
+    Q_DISABLE_COPY(MappedFile)
+
+    QFile file;
+    uchar *mapped;      //映射地址
+    QByteArray buffer;  //无法映射时（资源文件、空文件）的后备缓冲
+    const char *bytes;  //文件内容
+    qint64 length;
+    QDateTime modified; //映射时文件的修改时间
+    bool valid;
+};
+
+#endif // MAPPEDFILE_H
@@ -10,68 +10,252 @@
 #include <QToolTip>
 #include <QAction>
 #include <QPainter>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
 
 #include "notepad.h"
 #include "completer.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "lineindex.h"
+#include "patterncache.h"
+#include "literalmatcher.h"
+
+static const qint64 FirstChunkSize = 64 * 1024;   // 首屏在界面线程中解码的字节数
+static const qint64 ChunkSize = 256 * 1024;       // 后台每次解码的字节数
+static const int FollowRetryInterval = 500;       // 跟踪的文件轮转后等待新文件出现的间隔（毫秒）
+static const int NearbyChars = 64 * 1024;         // 边输入边查找时在界面线程中查找的范围（字符数）
 
 /**************MySyntaxHighlighterEditor******************/
+static const int HighlightMargin = 100;   // 可见范围上下马上高亮的块数
+static const int HighlightBatch = 1000;   // 空闲时每批交给工作线程的块数
+static const int HighlightInterval = 20;  // 两批之间的间隔（毫秒）
+static const int TypingPause = 500;       // 修改后暂停空闲高亮的时长（毫秒）
+
 MySyntaxHighlighterEditor::MySyntaxHighlighterEditor(QTextDocument *document)
-    : QSyntaxHighlighter(document)
+    : QSyntaxHighlighter(document), version(0), lexedSpans(0), lexedState(0), visibleFirst(0),
+      visibleLast(0), forcedBlock(-1), firstPending(std::numeric_limits<int>::max()), edits(0),
+      hits(0), misses(0)
 {
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(highlightPending()));
+    batchWatcher = new QFutureWatcher<Batch>(this);
+    connect(batchWatcher, SIGNAL(finished()), this, SLOT(batchLexed()));
+    if (document) {
+        connect(document, SIGNAL(contentsChange(int,int,int)), this, SLOT(contentsEdited()));
+    }
 }
 
 
 void MySyntaxHighlighterEditor::readSyntaxHighter(const QString &fileName)
 {
-    QFile file(fileName);
-    if (false == file.open(QIODevice::ReadOnly))
-    {
-        qDebug() << "Open file " << fileName << "error" << __FUNCTION__;
-    }
-
-    QTextStream readFileStream(&file);
-    QString keyWord;
-    QString readLineStr;
-    QStringList lineWordList;
-    QString matchReString;
-    QRegularExpression re("[ ]+");
-    int r, g, b;
-
-    while(!readFileStream.atEnd())
-    {
-        readLineStr = readFileStream.readLine();
-        if (readLineStr.startsWith("$$")) { //comment line
-            continue;
+    LanguagePointer language = LanguageRegistry::loadDefinition(fileName);
+    if (language) {
+        setLanguage(language);
+    }
+}
+
+// 缓存的结果和正在分析的一批都按旧的格式表，作废
+void MySyntaxHighlighterEditor::setLanguage(const LanguagePointer &language)
+{
+    if (language == lang) {
+        return;
+    }
+    lang = language;
+    ++version;
+    ++edits;
+    rehighlight();
+}
+
+void MySyntaxHighlighterEditor::setVisibleBlocks(int first, int last)
+{
+    visibleFirst = first;
+    visibleLast = last;
+    if (forcedBlock != -1) {
+        return; // 高亮引起的重绘请求
+    }
+
+    QTextBlock block = document()->findBlockByNumber(qMax(0, first - HighlightMargin));
+    for (int n = block.blockNumber(); block.isValid() && n <= last + HighlightMargin; ++n) {
+        if (isPending(block)) {
+            highlightNow(block);
+        }
+        block = block.next();
+    }
+}
+
+// 从第一个尚未高亮的块开始取一批连续的块，在工作线程中分析
+void MySyntaxHighlighterEditor::highlightPending()
+{
+    if (!lang || !lang->lexer || batchWatcher->isRunning()) {
+        return;
+    }
+
+    QTextBlock block = document()->findBlockByNumber(firstPending);
+    while (block.isValid() && !isPending(block)) {
+        block = block.next();
+    }
+    if (!block.isValid()) {
+        firstPending = std::numeric_limits<int>::max();
+        return;
+    }
+
+    Batch batch;
+    batch.first = firstPending = block.blockNumber();
+    batch.edits = edits;
+    batch.startState = qMax(0, block.previous().userState());
+    for (int n = 0; block.isValid() && n < HighlightBatch; ++n) {
+        batch.texts << block.text();
+        block = block.next();
+    }
+    batchWatcher->setFuture(QtConcurrent::run(&MySyntaxHighlighterEditor::lexBatch, lang->lexer, batch));
+}
+
+MySyntaxHighlighterEditor::Batch MySyntaxHighlighterEditor::lexBatch(QSharedPointer<const Lexer> lexer,
+                                                                     Batch batch)
+{
+    int state = batch.startState;
+    batch.spans.resize(batch.texts.size());
+    batch.states.resize(batch.texts.size());
+    for (int i = 0; i < batch.texts.size(); ++i) {
+        const QString &text = batch.texts.at(i);
+        state = lexer->lexLine(text.constData(), text.size(), state, &batch.spans[i]);
+        batch.states[i] = state;
+    }
+    return batch;
+}
+
+// 前一块的状态与分析时假设的相同才应用，否则从这一块起重新分析
+void MySyntaxHighlighterEditor::batchLexed()
+{
+    Batch batch = batchWatcher->result();
+    if (batch.edits != edits) {
+        idleTimer->start(TypingPause); // 期间文档被修改过，结果作废
+        return;
+    }
+
+    QTextBlock block = document()->findBlockByNumber(batch.first);
+    int state = batch.startState;
+    for (int i = 0; i < batch.texts.size() && block.isValid(); ++i) {
+        if (qMax(0, block.previous().userState()) != state) {
+            break;
         }
-        readLineStr.replace("\t", " ");
-        lineWordList = readLineStr.split(re);
-        if (lineWordList.size() != 4) {
-            continue;
+        if (isPending(block)) {
+            lexedSpans = &batch.spans.at(i);
+            lexedState = batch.states.at(i);
+            highlightNow(block);
+            lexedSpans = 0;
+        }
+        state = batch.states.at(i);
+        block = block.next();
+    }
+
+    // 最后一批也要再检查一次：没有尚未高亮的块时 highlightPending() 才把 firstPending 复位
+    if (block.isValid()) {
+        firstPending = qMin(firstPending, block.blockNumber());
+    }
+    idleTimer->start(HighlightInterval);
+}
+
+bool MySyntaxHighlighterEditor::hasPending() const
+{
+    return firstPending != std::numeric_limits<int>::max();
+}
+
+void MySyntaxHighlighterEditor::contentsEdited()
+{
+    if (forcedBlock != -1) {
+        return; // 高亮引起的格式变化
+    }
+
+    ++edits;
+    if (idleTimer->isActive() || firstPending != std::numeric_limits<int>::max()) {
+        idleTimer->start(TypingPause);
+    }
+}
+
+// 从未高亮过的块状态为 -1，高亮过之后又需要重新高亮的块有 pending 标记
+bool MySyntaxHighlighterEditor::isPending(const QTextBlock &block) const
+{
+    if (block.userState() == -1) {
+        return true;
+    }
+    HighlightData *data = static_cast<HighlightData *>(block.userData());
+    return data && data->pending;
+}
+
+void MySyntaxHighlighterEditor::highlightNow(const QTextBlock &block)
+{
+    forcedBlock = block.blockNumber();
+    rehighlightBlock(block);
+    forcedBlock = -1;
+}
+
+void MySyntaxHighlighterEditor::markPending(int blockNumber)
+{
+    if (currentBlockState() != -1) {
+        HighlightData *data = static_cast<HighlightData *>(currentBlockUserData());
+        if (!data) {
+            data = new HighlightData;
+            setCurrentBlockUserData(data);
         }
-        keyWord = lineWordList.at(0);
-        matchReString.append(keyWord);
-        matchReString.append("|");
-        r = lineWordList.at(1).toInt();
-        g = lineWordList.at(2).toInt();
-        b = lineWordList.at(3).toInt();
-        syntaxHightMap.insert(keyWord, QColor(r, g, b));
+        data->pending = true;
     }
-    matchReString.trimmed();
-    matchReExpression.setPattern(matchReString);
-    qDebug() << "matchReString:" << matchReString;
 
+    firstPending = qMin(firstPending, blockNumber);
+    if (!idleTimer->isActive()) {
+        idleTimer->start(TypingPause);
+    }
 }
 
+// 不在可见范围内的块只记下尚未高亮，状态保持不变，QSyntaxHighlighter 因此不会继续向后高亮
 void MySyntaxHighlighterEditor::highlightBlock(const QString &text)
 {
-    QTextCharFormat myClassFormat;
-    myClassFormat.setFontWeight(QFont::Bold);
-    QRegularExpressionMatchIterator i = matchReExpression.globalMatch(text);
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        myClassFormat.setForeground(QBrush(syntaxHightMap.value(match.captured())));
-        setFormat(match.capturedStart(), match.capturedLength(), myClassFormat);
+    int number = currentBlock().blockNumber();
+    if (number != forcedBlock
+            && (number < visibleFirst - HighlightMargin || number > visibleLast + HighlightMargin)) {
+        markPending(number);
+        return;
+    }
+
+    HighlightData *data = static_cast<HighlightData *>(currentBlockUserData());
+    if (!data) {
+        data = new HighlightData;
+        setCurrentBlockUserData(data);
+    }
+    data->pending = false;
+
+    // 文本和前一块的状态都没变时使用缓存的结果，否则重新分析：
+    // 可见的块直接在界面线程分析，其余的块使用工作线程的结果
+    int state = qMax(0, previousBlockState());
+    uint hash = qHash(text);
+    if (lexedSpans && number == forcedBlock) {
+        // 工作线程的结果只属于被强制高亮的这一块：状态变化后 QSyntaxHighlighter
+        // 会在同一次调用中接着高亮下一块，那一块要按自己的文本分析
+        data->spans = *lexedSpans;
+        data->endState = lexedState;
+        lexedSpans = 0;
+        ++misses;
+    } else if (data->version == version && data->hash == hash && data->startState == state) {
+        ++hits;
+    } else {
+        data->spans.clear();
+        const Lexer *lexer = lang ? lang->lexer.data() : 0;
+        data->endState = lexer ? lexer->lexLine(text.constData(), text.size(), state, &data->spans) : 0;
+        ++misses;
+    }
+    data->version = version;
+    data->hash = hash;
+    data->startState = state;
+
+    for (int i = 0; i < data->spans.size(); ++i) {
+        const TokenSpan &span = data->spans.at(i);
+        setFormat(span.start, span.length, lang->formats.at(span.format));
     }
+    setCurrentBlockState(data->endState);
 }
 
 /**************MyGCodeTextEdit******************/
@@ -79,19 +263,12 @@ void MySyntaxHighlighterEditor::highlightBlock(const QString &text)
 MyGCodeTextEdit::MyGCodeTextEdit(QWidget *parent):QPlainTextEdit(parent)
 {
     gCodeHighlighter = new MySyntaxHighlighterEditor(this->document());
-    gCodeHighlighter->readSyntaxHighter(QString(":/SynatxHight/C.txt")); //设置语法高亮文件
 
-    // 补全列表设置
-    QMap<QString, QColor>::iterator iter;
-    for (iter = gCodeHighlighter->syntaxHightMap.begin();
-         iter != gCodeHighlighter->syntaxHightMap.end(); ++iter) {
-        keyWordsList.append(iter.key());
-    }
-    qDebug() << "keyWordsList" << keyWordsList;
-
-    keyWordsComplter = new MyCompleter(keyWordsList);
+    // 补全列表使用语言共享的模型
+    keyWordsComplter = new MyCompleter(this);
     keyWordsComplter->setWidget(this);
     keyWordsComplter->setCaseSensitivity(Qt::CaseInsensitive);
+    keyWordsComplter->setModelSorting(QCompleter::CaseInsensitivelySortedModel);
     keyWordsComplter->setCompletionMode(QCompleter::PopupCompletion);
     keyWordsComplter->setMaxVisibleItems(6);
 
@@ -101,10 +278,15 @@ MyGCodeTextEdit::MyGCodeTextEdit(QWidget *parent):QPlainTextEdit(parent)
     lineSplitArea = new LineSplitArea(this);
     lineSplitArea->setVisible(true);
 
+    rightMargin = 0;
+
+    setLanguage(LanguageRegistry::language(QString("C"))); //新建的文件按 C 高亮（由 SynatxHight/C.txt 生成）
+
     connect(keyWordsComplter, SIGNAL(activated(QString)), this, SLOT(onCompleterActivated(QString)));
 
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateLineNumberAreaWidth(int)));
     connect(this, SIGNAL(updateRequest(QRect,int)), this, SLOT(updateLineNumberArea(QRect,int)));
+    connect(this, SIGNAL(updateRequest(QRect,int)), this, SLOT(updateVisibleBlocks()));
 
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateLineSplitAreaHeight(int)));
 
@@ -118,6 +300,12 @@ MyGCodeTextEdit::MyGCodeTextEdit(QWidget *parent):QPlainTextEdit(parent)
 
 }
 
+void MyGCodeTextEdit::setLanguage(const LanguagePointer &language)
+{
+    gCodeHighlighter->setLanguage(language);
+    keyWordsComplter->setModel(language->completionModel);
+}
+
 QString MyGCodeTextEdit::wordUnderCursor() const
 {
     // 不断向左移动cursor，并选中字符，并查看选中的单词中是否含有空格——空格作为单词的分隔符
@@ -141,7 +329,7 @@ QString MyGCodeTextEdit::wordUnderCursor() const
 int MyGCodeTextEdit::lineNumberAreaWidth()
 {
     int digits = 1;
-    int max = qMax(1, blockCount());
+    qint64 max = qMax<qint64>(1, lineCount());
     while (max >= 10) {
         max /= 10;
         ++digits;
@@ -189,8 +377,6 @@ void MyGCodeTextEdit::keyPressEvent(QKeyEvent *e)
 
         completerPrefix = this->wordUnderCursor();
 
-        qDebug() << "completerPrefix: " << completerPrefix;
-
         if (!completerPrefix.length()) {
             QAbstractItemView *popup = keyWordsComplter->popup();
             popup->hide();
@@ -229,8 +415,13 @@ void MyGCodeTextEdit::lineNumberAreaPaintEvent(QPaintEvent *event)
     QPainter painter(lineNumberArea);
     painter.fillRect(event->rect(), Qt::gray);
 
+    qint64 offset = lineNumberOffset();
+    if (offset < 0) {
+        return; // 行号还不知道
+    }
+
     QTextBlock block = firstVisibleBlock();
-    int blockNumber = block.blockNumber();
+    qint64 blockNumber = offset + block.blockNumber();
     int top = (int)blockBoundingGeometry(block).translated(contentOffset()).top();
     int bottom = top + (int) blockBoundingRect(block).height();
 
@@ -262,8 +453,6 @@ void MyGCodeTextEdit::onCompleterActivated(const QString &completion)
     QString completionPrefix = wordUnderCursor();
     QString shouldInertText = completion;
 
-    qDebug() << "comletion: " << completion;
-
     curTextCursor = textCursor();
     if (!completion.contains(completionPrefix)) {
         // delete the previously typed.
@@ -291,9 +480,30 @@ void MyGCodeTextEdit::onCurosPosChange()
     highlightCurrentLine();
 }
 
+qint64 MyGCodeTextEdit::currentLineNumber() const
+{
+    qint64 offset = lineNumberOffset();
+    return offset < 0 ? 0 : offset + textCursor().blockNumber() + 1;
+}
+
 void MyGCodeTextEdit::updateLineNumberAreaWidth(int /* newBlockCount */)
 {
-    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    setViewportMargins(lineNumberAreaWidth(), 0, rightMargin, 0);
+}
+
+void MyGCodeTextEdit::setExtraRightMargin(int margin)
+{
+    rightMargin = margin;
+    updateLineNumberAreaWidth(0);
+}
+
+void MyGCodeTextEdit::updateLineNumbers()
+{
+    updateLineNumberAreaWidth(0);
+
+    QRect cr = contentsRect();
+    lineNumberArea->setGeometry(QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
+    lineNumberArea->update();
 }
 
 void MyGCodeTextEdit::highlightCurrentLine()
@@ -328,6 +538,13 @@ void MyGCodeTextEdit::updateLineNumberArea(const QRect & rect, int dy)
     }
 }
 
+void MyGCodeTextEdit::updateVisibleBlocks()
+{
+    int first = firstVisibleBlock().blockNumber();
+    int lines = viewport()->height() / qMax(1, fontMetrics().height());
+    gCodeHighlighter->setVisibleBlocks(first, first + lines);
+}
+
 void MyGCodeTextEdit::updateLineSplitAreaHeight(int newBlockCount)
 {
     if (newBlockCount)
@@ -341,37 +558,543 @@ NotePad::NotePad(MyGCodeTextEdit *parent) :
     // 设置字体
     QFont font("Courier New", 10);
     this->setFont(font);
+
+    fileLoader = 0;
+    fileSaver = 0;
+    lineIndex = new LineIndex(this);
+    loadedBytes = 0;
+    appending = false;
+    edits = 0;
+    savedEdits = 0;
+    placeholder = false;
+    watcher = 0;
+    finder = new FindAll(this);
+    findingAll = false;
+    jumpFrom = -1;
+
+    connect(document(), SIGNAL(contentsChange(int,int,int)),
+            this, SLOT(updatePieceTable(int,int,int)));
+    connect(lineIndex, SIGNAL(progress()), this, SLOT(updateLineNumbers()));
+    connect(finder, SIGNAL(matchesReady()), this, SLOT(takeMatches()));
  }
 
-// 查找
-int NotePad::search(QString str, bool backward, bool matchCase, bool regExp)
+// 载入文件：首屏内容直接解码显示，其余部分由工作线程解码后逐段追加
+// 载入完成前文档只读且不记录撤销，避免追加的内容被撤销掉
+// 片段表直接引用文件的映射，载入的内容不会在片段表中再复制一份
+// 可编辑的标签页最终会把整个文件解码进文档，只在视口附近解码的是只读的大文件视图，
+// 超过 MainWindow 中大小上限的文件不会交到这里
+void NotePad::loadFile(FileLoader *loader)
 {
-    QTextDocument::FindFlags options;
+    fileLoader = loader;
+    fileLoader->setParent(this);
+
+    setReadOnly(true);
+    document()->setUndoRedoEnabled(false);
+    encoding = fileLoader->encoding();
+    buffer.setOriginal(fileLoader->mappedFile(), encoding);
+    lineIndex->build(fileLoader->mappedFile(), encoding);
+    loadedBytes = 0;
+    appendChunk(fileLoader->read(FirstChunkSize), fileLoader->pos());
+
+    if (fileLoader->atEnd()) {
+        finishLoading();
+        return;
+    }
+
+    emit progress(int(fileLoader->pos() * 100 / fileLoader->size()));
+    connect(fileLoader, SIGNAL(chunkReady()), this, SLOT(takeChunk()));
+    fileLoader->start(ChunkSize);
+}
+
+bool NotePad::isLoading() const
+{
+    return fileLoader != 0;
+}
 
-    if (backward) {
-        options = QTextDocument::FindBackward;
+// 载入剩余的全部内容（编辑、保存、查找前调用）
+void NotePad::loadAll()
+{
+    loadUntil(std::numeric_limits<qint64>::max());
+}
+
+// 载入到 bytes 处为止：停下工作线程，先追加它已经解码好的部分，再在当前线程解码到 bytes 处，
+// 还没有到文件末尾时让工作线程继续解码其余部分
+void NotePad::loadUntil(qint64 bytes)
+{
+    if (!isLoading() || loadedBytes > bytes) {
+        return;
     }
 
-    if (matchCase) {
-        options |= QTextDocument::FindCaseSensitively;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    fileLoader->stop();
+
+    QString text;
+    qint64 end;
+    while (fileLoader->takeChunk(&text, &end)) {
+        appendChunk(text, end - loadedBytes);
+    }
+    while (loadedBytes <= bytes && !fileLoader->atEnd()) {
+        text = fileLoader->read(ChunkSize);
+        appendChunk(text, fileLoader->pos() - loadedBytes);
     }
 
-    QTextCursor cursor = textCursor();
+    if (fileLoader->atEnd()) {
+        finishLoading();
+    } else {
+        emit progress(int(loadedBytes * 100 / fileLoader->size()));
+        fileLoader->start(ChunkSize);
+    }
+
+    QApplication::restoreOverrideCursor();
+
+    // 编码检查失败后换了编码重新载入（见 finishLoading()），要从头再载入到 bytes 处
+    if (isLoading() && loadedBytes <= bytes) {
+        loadUntil(bytes);
+    }
+}
+
+// 放弃载入，文档中只保留已载入的部分
+void NotePad::cancelLoading()
+{
+    if (!isLoading()) {
+        return;
+    }
+
+    fileLoader->close();
+    fileLoader->deleteLater();
+    fileLoader = 0;
+    lineIndex->clear();     // 之后文档中已有全部的块，行号由文档直接求出，编辑后也保持正确
+    updateLineNumbers();
+}
+
+// 每次只追加一段，两段之间界面可以继续响应滚动等操作
+void NotePad::takeChunk()
+{
+    if (!isLoading()) {
+        return;
+    }
+
+    QString text;
+    qint64 end;
+    if (fileLoader->takeChunk(&text, &end)) {
+        appendChunk(text, end - loadedBytes);
+        emit progress(int(end * 100 / fileLoader->size()));
+    }
+
+    if (fileLoader->isFinished()) {
+        finishLoading();
+    }
+}
+
+// 追加一段内容，片段表中只记录它在文件中的字节范围
+void NotePad::appendChunk(const QString &text, qint64 bytes)
+{
+    int length = document()->characterCount();
+
+    appending = true;
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+    appending = false;
+
+    buffer.appendOriginal(loadedBytes, bytes, document()->characterCount() - length);
+    loadedBytes += bytes;
+    document()->setModified(false);
+    applyViewState();
+}
+
+void NotePad::replaceContents(const QString &text)
+{
+    appending = true;
+    setPlainText(text);
+    appending = false;
+    document()->setModified(false);
+}
+
+// 文档的每次修改都同步到片段表，保存和查找随时可以从片段表取得与文档一致的快照；
+// 内容仍由 QTextDocument 保存，这里的开销只与修改的长度有关
+void NotePad::updatePieceTable(int position, int charsRemoved, int charsAdded)
+{
+    if (appending) {
+        return;
+    }
+
+    // 整体替换时 Qt 报告的长度可能包含文档末尾的段落分隔符，按实际长度修正
+    int length = document()->characterCount() - 1;
+    charsAdded = qMax(0, qMin(charsAdded, length - position));
+    charsRemoved = charsAdded + buffer.length() - length;
+
+    QString text;
+    if (charsAdded > 0) {
+        QTextCursor cursor(document());
+        cursor.setPosition(position);
+        cursor.setPosition(position + charsAdded, QTextCursor::KeepAnchor);
+        text = cursor.selectedText().replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    }
+
+    // 只改变了格式（例如语法高亮），文本没有变化
+    if (charsRemoved == charsAdded && buffer.text(position, charsRemoved) == text) {
+        return;
+    }
+
+    buffer.remove(position, charsRemoved);
+    buffer.insert(position, text);
+    ++edits;
+
+    // 匹配的位置已经不对了
+    clearFindAll();
+}
+
+// 片段表中未修改的文本读自原始文件的映射。文件被其他程序改写（如日志轮转的 copytruncate）后，
+// 映射中已是新的内容，截断后读取还会越过文件末尾；这时文档中的内容才是正确的，
+// 用它重建片段表，保存和查找不再读取原始文件。载入期间工作线程仍在按映射解码，不在这里处理
+void NotePad::checkOriginal()
+{
+    if (isLoading() || !buffer.isStale()) {
+        return;
+    }
+
+    QTextCursor cursor(document());
+    cursor.select(QTextCursor::Document);
+    buffer.reset(cursor.selectedText().replace(QChar::ParagraphSeparator, QLatin1Char('\n')));
+}
+
+const PieceTable &NotePad::pieceTable()
+{
+    checkOriginal();
+    return buffer;
+}
+
+void NotePad::finishLoading()
+{
+    // 打开时只按样本检测编码，解码中发现其余内容不符合时，按检查全部内容得到的编码重新载入
+    if (fileLoader->hasWrongEncoding()) {
+        FileEncoding detected = fileLoader->detectedEncoding();
+        FileLoader *loader = new FileLoader(fileLoader->fileName());
+        if (loader->open(detected.bomLength(), detected)) {
+            fileLoader->close();
+            fileLoader->deleteLater();
+            fileLoader = 0;
+
+            appending = true;
+            clear();
+            appending = false;
+            loadFile(loader);
+            return;
+        }
+        delete loader;
+    }
+
+    fileLoader->close();
+    fileLoader->deleteLater();
+    fileLoader = 0;
+    lineIndex->clear();
 
-    cursor = regExp ? document()->find(QRegExp(str), cursor, options) :
-                      document()->find(str, cursor, options);
+    document()->setUndoRedoEnabled(!isFollowing());
+    document()->setModified(false);
+    setReadOnly(isFollowing());
+    highlightCurrentLine();
+    applyViewState();
+
+    emit progress(100);
+    emit loadFinished();
+
+    if (isFollowing()) {
+        readAppended(); // 载入期间新写入的内容
+    }
+}
+
+qint64 NotePad::lineCount() const
+{
+    return qMax(MyGCodeTextEdit::lineCount(), isLoading() ? lineIndex->lineCount() : 0);
+}
+
+// 跳到第 line 行：尚未载入时按换行索引求出它在文件中的位置，只载入到那里
+bool NotePad::goToLine(qint64 line)
+{
+    if (isLoading() && line > blockCount()) {
+        qint64 offset = lineIndex->lineOffset(line);    // 下一行的行首
+        if (offset < 0) {
+            loadAll();
+        } else {
+            loadUntil(offset - 1);
+        }
+    }
+
+    QTextCursor cursor(document()->findBlockByNumber(int(qBound<qint64>(1, line, blockCount())) - 1));
+    setTextCursor(cursor);
+    centerCursor();
+    return true;
+}
+
+// 跟踪文件末尾：文件增长时只解码新增的字节追加到文档末尾，跟踪期间文档只读
+bool NotePad::setFollowing(bool on)
+{
+    if (on == isFollowing()) {
+        return true;
+    }
+
+    if (!on) {
+        delete watcher;
+        watcher = 0;
+        followedFile.clear();
+        if (!isLoading()) {
+            document()->setUndoRedoEnabled(true);
+            setReadOnly(false);
+            highlightCurrentLine();
+        }
+        return true;
+    }
 
-    if (cursor.isNull()) {
+    if (placeholder || document()->isModified() || buffer.originalFileName().isEmpty()) {
         return false;
     }
 
+    followedFile = buffer.originalFileName();
+    watcher = new QFileSystemWatcher(QStringList() << followedFile, this);
+    connect(watcher, SIGNAL(fileChanged(QString)), this, SLOT(readAppended()));
+
+    setReadOnly(true);
+    document()->setUndoRedoEnabled(false);
+    highlightCurrentLine();
+    readAppended();
+    return true;
+}
+
+// 新增的内容在片段表中同样只记录字节范围，开销只与新增的字节数有关
+void NotePad::readAppended()
+{
+    if (!isFollowing() || isLoading()) {
+        return; // 载入结束时会再读一次
+    }
+
+    // 文件被改名或删除（日志轮转）时监视随之失效，等新文件出现后重新载入
+    if (!watcher->files().contains(followedFile)) {
+        if (!QFileInfo::exists(followedFile)) {
+            QTimer::singleShot(FollowRetryInterval, this, SLOT(readAppended()));
+            return;
+        }
+        watcher->addPath(followedFile);
+        reloadFollowed();
+        return;
+    }
+
+    qint64 size = QFileInfo(followedFile).size();
+    if (size < loadedBytes) {
+        reloadFollowed();   // 被截断
+        return;
+    }
+    if (size == loadedBytes) {
+        return;
+    }
+
+    FileLoader loader(followedFile);
+    if (!loader.open(loadedBytes, encoding)) {
+        return;
+    }
+    buffer.remap(loader.mappedFile());
+
+    // 原来停在末尾时继续滚动到末尾
+    QScrollBar *bar = verticalScrollBar();
+    bool atEnd = bar->value() == bar->maximum();
+
+    // 末尾正在写入的不完整的行留到下次再读
+    while (!loader.atEnd()) {
+        QString text = loader.read(ChunkSize, true);
+        if (loader.pos() == loadedBytes) {
+            break;
+        }
+        appendChunk(text, loader.pos() - loadedBytes);
+    }
+
+    if (atEnd) {
+        bar->setValue(bar->maximum());
+    }
+}
+
+void NotePad::reloadFollowed()
+{
+    FileLoader *loader = new FileLoader(followedFile);
+    if (!loader->open()) {
+        delete loader;
+        return;
+    }
+
+    appending = true;
+    clear();
+    appending = false;
+    loadFile(loader);
+}
+
+// 光标位置和第一个可见行，占位标签页返回恢复会话时读到的值
+QVariantList NotePad::viewState() const
+{
+    if (placeholder || !pendingView.isEmpty()) {
+        return pendingView;
+    }
+    return QVariantList() << textCursor().position() << verticalScrollBar()->value();
+}
+
+void NotePad::restoreViewState(const QVariantList &state)
+{
+    pendingView = state;
+    applyViewState();
+}
+
+void NotePad::applyViewState()
+{
+    if (placeholder || pendingView.size() != 2) {
+        return;
+    }
+
+    int position = pendingView.at(0).toInt();
+    int line = pendingView.at(1).toInt();
+    if (isLoading() && (document()->characterCount() <= position || blockCount() <= line)) {
+        return; // 还没有载入到那里
+    }
+
+    QTextCursor cursor(document());
+    cursor.setPosition(qBound(0, position, document()->characterCount() - 1));
     setTextCursor(cursor);
+    verticalScrollBar()->setValue(line);
+    pendingView.clear();
+}
+
+// 在后台保存到文件：文档的快照被写入临时文件，完成后原子地替换原文件
+// 成功且期间没有再修改时文档被标记为未修改（发出 modificationChanged），结果通过 saveFinished 返回
+bool NotePad::saveFile(const QString &fileName)
+{
+    loadAll();
+    checkOriginal();
+
+    // 新的保存取代尚未完成的保存，未提交的临时文件会被丢弃
+    delete fileSaver;
+
+#ifdef Q_OS_WIN
+    // Windows 下被映射的文件不能被替换，覆盖原文件前先把原始内容复制到内存
+    if (QFileInfo(buffer.originalFileName()) == QFileInfo(fileName)) {
+        buffer.detach();
+    }
+#endif
+
+    // 工作线程只读取片段表的快照，保存期间可以继续编辑
+    savedEdits = edits;
+    fileSaver = new FileSaver(buffer, fileName, encoding, this);
+    connect(fileSaver, SIGNAL(progress(int)), this, SIGNAL(progress(int)));
+    connect(fileSaver, SIGNAL(finished(bool)), this, SLOT(saverFinished(bool)));
+    fileSaver->start();
+    return true;
+}
+
+bool NotePad::isSaving() const
+{
+    return fileSaver != 0;
+}
+
+// 等待后台保存结束（关闭文档前调用）
+bool NotePad::waitForSaved()
+{
+    if (fileSaver) {
+        fileSaver->waitForFinished();
+    }
+    return !document()->isModified();
+}
+
+void NotePad::saverFinished(bool success)
+{
+    if (success && edits == savedEdits) {
+        // 磁盘上已是最新内容：片段表改为引用新文件，追加缓冲中的内容不再占用内存
+        QSharedPointer<MappedFile> file(new MappedFile(fileSaver->fileName()));
+        if (file->isValid()) {
+            buffer.rebase(fileSaver->savedLayout(), file);
+        }
+        document()->setModified(false);
+    }
+
+    QString error = fileSaver->errorString();
+    fileSaver->deleteLater();
+    fileSaver = 0;
+    emit saveFinished(success, error);
+}
+
+// 判断按键是否会修改文档
+static bool isEditKey(QKeyEvent *e)
+{
+    if (e->matches(QKeySequence::Paste) || e->matches(QKeySequence::Cut)
+            || e->matches(QKeySequence::Undo) || e->matches(QKeySequence::Redo)) {
+        return true;
+    }
+
+    switch (e->key()) {
+        case Qt::Key_Backspace:
+        case Qt::Key_Delete:
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+        case Qt::Key_Tab:
+            return true;
+        default:
+            break;
+    }
+
+    return !e->text().isEmpty() && e->text().at(0).isPrint();
+}
+
+void NotePad::keyPressEvent(QKeyEvent *e)
+{
+    // 第一次编辑前先把剩余内容载入，之后文档才可编辑
+    if (isLoading() && isEditKey(e)) {
+        loadAll();
+    }
+    MyGCodeTextEdit::keyPressEvent(e);
+}
+
+// 查找：在片段表中查找，找到后选中
+int NotePad::search(QString str, bool backward, bool matchCase, bool regExp)
+{
+    loadAll();
+    checkOriginal();
+
+    QTextCursor cursor = textCursor();
+    Qt::CaseSensitivity cs = matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    int from = backward ? cursor.selectionStart() - 1 : cursor.selectionEnd();
+    int length = str.size();
+    int pos;
+
+    if (regExp) {
+        QRegularExpression re = PatternCache::pattern(str, matchCase);
+        if (!re.isValid()) {
+            return false;
+        }
+        pos = buffer.find(re, from, backward, &length);
+    } else {
+        pos = buffer.find(str, from, backward, cs);
+    }
+
+    if (pos == -1) {
+        return false;
+    }
+
+    select(pos, length);
     return true;
 }
 
+void NotePad::select(int position, int length)
+{
+    QTextCursor cursor(document());
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+}
+
 // 替换
 void NotePad::replace(QString str1, QString str2, bool backward, bool matchCase, bool regExp)
 {
+    loadAll();
+    if (isReadOnly()) {
+        return;
+    }
+
     QTextCursor cursor = textCursor();
 
     if (!cursor.hasSelection()) {
@@ -390,20 +1113,308 @@ void NotePad::replace(QString str1, QString str2, bool backward, bool matchCase,
     }
 }
 
-// 替换所有
-void NotePad::replaceAll(QString str1, QString str2, bool matchCase, bool regExp)
+// 替换文本中的 \1 ~ \9 换成对应的捕获组，\0 为整个匹配，\\ 为反斜杠
+static QString expandCaptures(const QString &after, const QRegularExpressionMatch &match)
 {
-    QTextCursor cursor = textCursor();
+    QString result;
+    for (int i = 0; i < after.size(); ++i) {
+        QChar c = after.at(i);
+        if (c == QLatin1Char('\\') && i + 1 < after.size()) {
+            QChar next = after.at(i + 1);
+            if (next.isDigit() && next.digitValue() <= match.lastCapturedIndex()) {
+                result += match.captured(next.digitValue());
+                ++i;
+                continue;
+            }
+            if (next == QLatin1Char('\\')) {
+                result += next;
+                ++i;
+                continue;
+            }
+        }
+        result += c;
+    }
+    return result;
+}
 
-    cursor.setPosition(0, QTextCursor::MoveAnchor);
-    setTextCursor(cursor);
+// 替换所有：一次扫描全部文本，在一个缓冲中拼出第一个到最后一个匹配之间的新内容，
+// 作为一次编辑应用（只占一个撤销步骤，只重新排版、高亮这一段），光标和滚动位置不变
+int NotePad::replaceAll(QString str1, QString str2, bool matchCase, bool regExp)
+{
+    loadAll();
+    checkOriginal();
+    if (isReadOnly() || str1.isEmpty()) {
+        return 0;
+    }
+
+    Qt::CaseSensitivity cs = matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    QString text = buffer.text(0, buffer.length());
+    QString result;
+    int first = -1; // 第一个匹配的起点
+    int last = 0; // 上一个匹配的终点
+    int count = 0;
+
+    if (regExp) {
+        // 与查找一样逐行匹配
+        QRegularExpression re = PatternCache::pattern(str1, matchCase);
+        if (!re.isValid()) {
+            return 0;
+        }
+        for (int lineStart = 0; lineStart <= text.size(); ) {
+            int lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+            if (lineEnd == -1) {
+                lineEnd = text.size();
+            }
+            QString line = text.mid(lineStart, lineEnd - lineStart);
+            for (int pos = 0; pos <= line.size(); ) {
+                QRegularExpressionMatch match = re.match(line, pos);
+                if (!match.hasMatch()) {
+                    break;
+                }
+                int start = lineStart + match.capturedStart();
+                if (first == -1) {
+                    first = start;
+                } else {
+                    result += text.midRef(last, start - last);
+                }
+                result += expandCaptures(str2, match);
+                last = start + match.capturedLength();
+                ++count;
+
+                pos = match.capturedEnd() + (match.capturedLength() == 0); // 空匹配之后至少前进一个字符
+            }
+            lineStart = lineEnd + 1;
+        }
+    } else {
+        LiteralMatcher matcher(str1, cs);
+        for (int pos = matcher.indexIn(text.constData(), text.size(), 0); pos != -1;
+             pos = matcher.indexIn(text.constData(), text.size(), last)) {
+            if (first == -1) {
+                first = pos;
+            } else {
+                result += text.midRef(last, pos - last);
+            }
+            result += str2;
+            last = pos + str1.size();
+            ++count;
+        }
+    }
+
+    if (count > 0) {
+        int scrollX = horizontalScrollBar()->value();
+        int scrollY = verticalScrollBar()->value();
 
-    while (search(str1, false, matchCase, regExp)) {
-        replace(str1, str2, false, matchCase, regExp);
+        // 不经过 textCursor()：光标由文档自动调整，视图不跟着跳
+        QTextCursor cursor(document());
+        cursor.setPosition(first);
+        cursor.setPosition(last, QTextCursor::KeepAnchor);
+        cursor.beginEditBlock();
+        cursor.insertText(result);
+        cursor.endEditBlock();
+
+        horizontalScrollBar()->setValue(scrollX);
+        verticalScrollBar()->setValue(scrollY);
+    }
+
+    emit replacedAll(count);
+    return count;
+}
+
+// 全部查找：工作线程扫描片段表的快照，找到的匹配分批取回，随时可以编辑（编辑后结果作废）
+void NotePad::findAll(QString str, bool matchCase, bool regExp)
+{
+    loadAll();
+    checkOriginal();
+    clearFindAll();
+    if (str.isEmpty()) {
+        emit findAllFinished(0);
+        return;
+    }
+
+    findingAll = true;
+    finder->start(buffer, str, matchCase, regExp);
+}
+
+static bool matchBefore(const FindMatch &match, int position)
+{
+    return match.position < position;
+}
+
+// 边输入边查找：先在选区开头之后不远处同步查找，马上跳过去；同时在后台统计全部匹配，
+// 附近没有时等后台找到之后的第一个匹配再跳。不强制载入剩余内容，只查已载入的部分。
+// 上一次尚未结束的后台查找由 clearFindAll() 停掉
+void NotePad::incrementalSearch(QString str, bool matchCase, bool regExp)
+{
+    clearFindAll();
+    checkOriginal();
+    if (str.isEmpty() || (regExp && !PatternCache::pattern(str, matchCase).isValid())) {
+        return;
+    }
+
+    int from = textCursor().selectionStart();
+    int length = 0;
+    int pos = findNearby(str, from, matchCase, regExp, &length);
+    if (pos != -1) {
+        select(pos, length);
+    }
+
+    findingAll = true;
+    jumpFrom = pos == -1 ? from : -1;
+    finder->start(buffer, str, matchCase, regExp);
+}
+
+// 与 search() 相同的匹配规则（正则表达式逐行匹配，不计空匹配），但只查 from 之后 NearbyChars 个字符
+int NotePad::findNearby(const QString &str, int from, bool matchCase, bool regExp, int *length) const
+{
+    if (!regExp) {
+        QString window = buffer.text(from, NearbyChars + str.size() - 1);
+        LiteralMatcher matcher(str, matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        int i = matcher.indexIn(window.constData(), window.size(), 0);
+        *length = str.size();
+        return i == -1 ? -1 : from + i;
+    }
+
+    QRegularExpression re = PatternCache::pattern(str, matchCase);
+    int start = buffer.find(QString(QLatin1Char('\n')), from - 1, true, Qt::CaseSensitive) + 1;  // 所在行的行首
+    QString window = buffer.text(start, from - start + NearbyChars);
+    if (start + window.size() < buffer.length()) {
+        window.truncate(window.lastIndexOf(QLatin1Char('\n')) + 1);  // 不查被截断的最后一行
+    }
+    for (int lineStart = 0; lineStart < window.size(); ) {
+        int lineEnd = window.indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd == -1) {
+            lineEnd = window.size();
+        }
+        QString line = window.mid(lineStart, lineEnd - lineStart);
+        for (int pos = qMax(0, from - start - lineStart); pos <= line.size(); ) {
+            QRegularExpressionMatch match = re.match(line, pos);
+            if (!match.hasMatch()) {
+                break;
+            }
+            if (match.capturedLength() > 0) {
+                *length = match.capturedLength();
+                return start + lineStart + match.capturedStart();
+            }
+            pos = match.capturedEnd() + 1;
+        }
+        lineStart = lineEnd + 1;
+    }
+    return -1;
+}
+
+void NotePad::takeMatches()
+{
+    if (!findingAll) {
+        return; // 已清除的查找
+    }
+
+    QVector<FindMatch> found = finder->takeMatches();
+    if (!found.isEmpty()) {
+        if (jumpFrom != -1) {
+            QVector<FindMatch>::const_iterator it = std::lower_bound(found.constBegin(), found.constEnd(),
+                                                                     jumpFrom, matchBefore);
+            if (it != found.constEnd()) {
+                select(it->position, it->length);
+                jumpFrom = -1;
+            }
+        }
+        matches += found;
+        viewport()->update();
+        emit matchesFound(matches.size());
+    }
+    if (finder->isFinished()) {
+        findingAll = false;
+        if (jumpFrom != -1 && !matches.isEmpty()) {
+            select(matches.first().position, matches.first().length);   // 之后没有匹配，从头开始
+        }
+        jumpFrom = -1;
+        emit findAllFinished(matches.size());
+    }
+}
+
+void NotePad::clearFindAll()
+{
+    if (!findingAll && matches.isEmpty()) {
+        return;
+    }
+
+    finder->stop();
+    findingAll = false;
+    jumpFrom = -1;
+    matches.clear();
+    matches.squeeze();
+    viewport()->update();
+    emit findAllCleared();
+}
+
+void NotePad::showMatch(int index)
+{
+    if (index >= 0 && index < matches.size()) {
+        select(matches.at(index).position, matches.at(index).length);
+    }
+}
+
+// 匹配互不重叠，按起点排序时终点也是有序的
+static bool matchEndsBefore(const FindMatch &match, int position)
+{
+    return match.position + match.length <= position;
+}
+
+// 在可见的块上叠加全部查找的标记：二分找到第一个终点在可见范围内的匹配（它可能从视口上方开始），
+// 只画可见的部分；跨块的匹配在它经过的每一块中都画出
+void NotePad::paintEvent(QPaintEvent *e)
+{
+    MyGCodeTextEdit::paintEvent(e);
+    if (matches.isEmpty()) {
+        return;
+    }
+
+    QTextBlock block = firstVisibleBlock();
+    QVector<FindMatch>::const_iterator first = std::lower_bound(matches.constBegin(), matches.constEnd(),
+                                                                block.position(), matchEndsBefore);
+    QPainter painter(viewport());
+    QColor color(255, 200, 0, 110);
+    QPointF offset = contentOffset();
+
+    while (block.isValid() && first != matches.constEnd()) {
+        QRectF rect = blockBoundingGeometry(block).translated(offset);
+        if (rect.top() > e->rect().bottom()) {
+            break;
+        }
+
+        QTextLayout *layout = block.layout();
+        int blockStart = block.position();
+        int blockEnd = blockStart + block.length();
+        while (first != matches.constEnd() && matchEndsBefore(*first, blockStart)) {
+            ++first;    // 在这一块之前已经结束
+        }
+        for (QVector<FindMatch>::const_iterator it = first;
+             it != matches.constEnd() && it->position < blockEnd; ++it) {
+            int from = qMax(0, it->position - blockStart);
+            int to = qMin(it->position + it->length - blockStart, block.length() - 1);
+            for (int i = 0; i < layout->lineCount(); ++i) {
+                QTextLine line = layout->lineAt(i);
+                int lineStart = line.textStart();
+                int lineEnd = lineStart + line.textLength();
+                if (to <= lineStart || from >= lineEnd) {
+                    continue;
+                }
+                qreal x1 = line.cursorToX(qMax(from, lineStart));
+                qreal x2 = line.cursorToX(qMin(to, lineEnd));
+                painter.fillRect(QRectF(x1, line.y(), x2 - x1, line.height()).translated(rect.topLeft()), color);
+            }
+        }
+        block = block.next();
     }
 }
 
 NotePad::~NotePad()
 {
+    cancelLoading();
 
+    // 文档还在，先把尚未完成的保存写完
+    if (fileSaver) {
+        disconnect(fileSaver, 0, this, 0);
+        fileSaver->waitForFinished();
+    }
 }
@@ -6,25 +6,85 @@
 
 #include <QtWidgets>
 
+#include "piecetable.h"
+#include "language.h"
+#include "findall.h"
+
 typedef struct SyntaxHight {
     QString keyWord;
     QColor   highlightColor;
 }SyntaxHight_T;
 
+// 高亮过的块的附加数据
+class HighlightData : public QTextBlockUserData
+{
+public:
+    HighlightData() : pending(false), version(-1), hash(0), startState(0), endState(0) {}
+    bool pending; // 内容或前一块的状态变了，但不在可见范围内，尚未重新高亮
+
+    // 上次分析的结果：语法定义、文本和前一块的状态都没变时直接使用
+    int version; // 分析时语法定义的版本
+    uint hash; // 文本的散列值
+    int startState;
+    int endState;
+    QVector<TokenSpan> spans;
+};
+
+// 只马上高亮可见的块（及附近的块），其余的块在空闲时分批交给工作线程分析，
+// 界面线程只应用分析结果；正在输入时暂停
 class MySyntaxHighlighterEditor : public QSyntaxHighlighter {
 
     Q_OBJECT
 
 public:
     MySyntaxHighlighterEditor(QTextDocument *document = 0);
-    void readSyntaxHighter(const QString &fileName);
-    QMap<QString, QColor> syntaxHightMap; // 保存语法高亮信息
+    void readSyntaxHighter(const QString &fileName); //使用用户提供的语法定义文件
+    void setLanguage(const LanguagePointer &language); //换用另一种语言，全部重新高亮
+    LanguagePointer language() const { return lang; }
+    void setVisibleBlocks(int first, int last); //可见的块，其中尚未高亮的马上高亮
+    int cacheHits() const { return hits; } //使用缓存的分析结果的次数
+    int cacheMisses() const { return misses; } //重新分析的次数
+    void resetCacheCounters() { hits = misses = 0; }
+    bool hasPending() const; //还有尚未高亮的块（空闲时的高亮全部完成后为假）
 
 protected:
     void highlightBlock(const QString &text);
 
+private slots:
+    void highlightPending(); //空闲时把一批尚未高亮的块交给工作线程分析
+    void batchLexed(); //应用工作线程的分析结果
+    void contentsEdited(); //文档被修改，暂停空闲时的高亮
+
 private:
-    QRegularExpression matchReExpression;
+    // 交给工作线程的一批连续的块：文本是快照，结果只在期间文档没有修改时应用
+    struct Batch {
+        int first; // 第一块的块号
+        int edits; // 取快照时文档的修改次数
+        int startState; // 第一块之前的状态
+        QStringList texts;
+        QVector<QVector<TokenSpan> > spans;
+        QVector<int> states; // 各块结束时的状态
+    };
+
+    static Batch lexBatch(QSharedPointer<const Lexer> lexer, Batch batch); //工作线程
+    bool isPending(const QTextBlock &block) const;
+    void highlightNow(const QTextBlock &block);
+    void markPending(int blockNumber);
+
+    LanguagePointer lang; // 与其他标签页共享，只读
+    int version; // 语法定义的版本
+    const QVector<TokenSpan> *lexedSpans; // 正在应用的工作线程结果
+    int lexedState;
+
+    int visibleFirst; // 可见的块的范围
+    int visibleLast;
+    int forcedBlock; // 正在强制高亮的块
+    int firstPending; // 尚未高亮的块不早于这一块
+    int edits; // 文档被修改的次数
+    int hits;
+    int misses;
+    QTimer *idleTimer;
+    QFutureWatcher<Batch> *batchWatcher;
 
 };
 
@@ -39,19 +99,29 @@ public:
     MyGCodeTextEdit(QWidget *parent  = 0);
     //void setCompleter(QCompleter *completer);
     QString wordUnderCursor() const;
+    const MySyntaxHighlighterEditor *highlighter() const { return gCodeHighlighter; }
+    void setLanguage(const LanguagePointer &language); //高亮和补全使用的语言
     int lineNumberAreaWidth();
+    virtual qint64 lineCount() const { return qMax<qint64>(0, lineNumberOffset()) + blockCount(); } //总行数（决定行号区的宽度）
+    qint64 currentLineNumber() const; //光标所在行的行号（从 1 开始），未知时为 0
     void lineNumberAreaPaintEvent(QPaintEvent *event);
     void lineSplitAreaPaintEvent(QPaintEvent *event);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
     void keyPressEvent(QKeyEvent *e);
+    virtual qint64 lineNumberOffset() const { return 0; } //第一个文本块之前的行数，未知时为 -1
+    void setExtraRightMargin(int margin); //视口右侧留出的宽度
 
-private slots:
-    void updateLineNumberAreaWidth(int newBlockCount);
+protected slots:
     void highlightCurrentLine();
+    void updateLineNumberAreaWidth(int newBlockCount);
+    void updateLineNumbers(); //行号的起点或总行数改变后重画行号区
+
+private slots:
     void updateLineNumberArea(const QRect &, int);
     void updateLineSplitAreaHeight(int newBlockCount);
+    void updateVisibleBlocks(); //把可见范围告诉高亮器
 
 public slots:
     void onCompleterActivated(const QString &completion);
@@ -60,7 +130,6 @@ public slots:
 private:
     MySyntaxHighlighterEditor *gCodeHighlighter;
     QCompleter *keyWordsComplter;
-    QStringList keyWordsList;
     QTextCursor curTextCursor;
     QRect curTextCursorRect;
     QString completerPrefix;
@@ -70,6 +139,8 @@ private:
 
     QWidget *lineSplitArea;
 
+    int rightMargin;
+
 };
 
 class LineNumberArea : public QWidget
@@ -135,6 +206,10 @@ private:
 };
 
 
+class FileLoader;
+class FileSaver;
+class LineIndex;
+
 class NotePad: public MyGCodeTextEdit
 {
     Q_OBJECT
@@ -143,10 +218,83 @@ class NotePad: public MyGCodeTextEdit
 public:
     NotePad(MyGCodeTextEdit *parent = 0);
     ~NotePad();
+    void loadFile(FileLoader *loader); //载入文件，首屏之后的内容在后台解码
+    bool isLoading() const; //文件是否尚未完全载入
+    void loadAll(); //载入剩余的全部内容
+    void loadUntil(qint64 bytes); //载入到文件的 bytes 处为止，其余部分继续在后台载入
+    void cancelLoading(); //放弃载入（关闭标签页时调用）
+    virtual bool saveFile(const QString &fileName); //在后台保存到文件
+    bool isSaving() const; //后台保存是否尚未结束
+    bool waitForSaved(); //等待后台保存结束，返回文档是否已保存
+    const PieceTable &pieceTable(); //与文档内容同步的片段表（保存、查找用的快照来源）
+    FileEncoding fileEncoding() const { return encoding; } //文件的编码，保存时按它写回
+    bool isPlaceholder() const { return placeholder; } //是否为尚未载入的占位标签页
+    void setPlaceholder(bool on) { placeholder = on; }
+    QVariantList viewState() const; //光标和滚动位置（保存会话时使用）
+    void restoreViewState(const QVariantList &state); //恢复光标和滚动位置（内容载入到该处后生效）
+    bool setFollowing(bool on); //开始或停止跟踪文件末尾（有未保存的修改时不能开始）
+    bool isFollowing() const { return watcher != 0; }
+    qint64 lineCount() const override; //载入完成前按换行索引计算
+    virtual bool goToLine(qint64 line); //跳到第 line 行（从 1 开始）
+    const QVector<FindMatch> &findMatches() const { return matches; } //全部查找已找到的匹配（按位置排序）
+    bool isFindingAll() const { return findingAll; } //全部查找是否尚未结束
+
+signals:
+    void progress(int percent); //载入或保存的进度
+    void loadFinished(); //文件已全部载入
+    void saveFinished(bool success, const QString &error); //后台保存结束
+    void replacedAll(int count); //全部替换结束，count 为替换的个数
+    void matchesFound(int total); //全部查找找到了新的一批，total 为目前的个数
+    void findAllFinished(int total); //全部查找结束
+    void findAllCleared(); //全部查找的结果已清除（文档被修改或重新查找）
+
 public slots:
-    int search(QString, bool, bool, bool); //查找
+    virtual int search(QString, bool, bool, bool); //查找
     void replace(QString, QString, bool, bool, bool);   //替换
-    void replaceAll(QString, QString, bool, bool);  //替换所有
+    int replaceAll(QString, QString, bool, bool);  //替换所有，返回替换的个数
+    virtual void findAll(QString, bool, bool);  //在后台查找全部匹配并标记出来
+    virtual void incrementalSearch(QString, bool, bool);    //边输入边查找：跳到选区开头之后最近的匹配，并在后台统计全部匹配
+    void clearFindAll();    //停止全部查找并去掉标记
+    void showMatch(int index);  //选中全部查找的第 index 个匹配
+
+protected:
+    void keyPressEvent(QKeyEvent *e) override;
+    void paintEvent(QPaintEvent *e) override;
+    void replaceContents(const QString &text); //替换全部内容，不同步到片段表（只读视图使用）
+
+private slots:
+    void takeChunk(); //追加一段后台解码好的内容
+    void saverFinished(bool success);
+    void updatePieceTable(int position, int charsRemoved, int charsAdded); //把文档的修改同步到片段表
+    void readAppended(); //读取文件末尾新增的内容
+    void takeMatches(); //取走全部查找新找到的匹配
+
+private:
+    void appendChunk(const QString &text, qint64 bytes); //追加一段内容（不进入撤销栈）
+    void finishLoading();
+    void checkOriginal(); //原始文件被其他程序改动时，改由文档内容重建片段表
+    void select(int position, int length); //选中一段文本
+    int findNearby(const QString &str, int from, bool matchCase, bool regExp, int *length) const; //只在 from 之后不远处查找
+    void applyViewState(); //内容已载入到保存的位置时恢复光标和滚动位置
+    void reloadFollowed(); //跟踪的文件被截断或轮转，重新载入
+
+    FileLoader *fileLoader; //尚未载入完毕的文件
+    LineIndex *lineIndex; //载入期间文件的换行索引（跳转到尚未载入的行时使用）
+    FileSaver *fileSaver; //正在进行的后台保存
+    PieceTable buffer; //与文档同步的快照来源：引用原始文件的映射，另外只保存修改过的部分
+    FileEncoding encoding; //打开时检测到的编码
+    qint64 loadedBytes; //已追加到文档中的字节数
+    bool appending; //正在追加载入的内容，不必同步到片段表
+    int edits; //片段表被修改的次数
+    int savedEdits; //开始保存时的修改次数
+    bool placeholder; //尚未载入的占位标签页
+    QVariantList pendingView; //等待恢复的光标和滚动位置
+    QFileSystemWatcher *watcher; //跟踪文件末尾时监视文件的变化
+    QString followedFile; //正在跟踪的文件
+    FindAll *finder; //全部查找的工作线程
+    QVector<FindMatch> matches; //全部查找已找到的匹配，在视口上叠加标记（不使用 ExtraSelection）
+    bool findingAll;
+    int jumpFrom; //边输入边查找时附近没有匹配，等全部查找找到 jumpFrom 之后的第一个匹配再跳过去（-1 表示不跳）
 
 };
 
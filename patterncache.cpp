@@ -0,0 +1,23 @@
+#include <QCache>
+
+#include "patterncache.h"
+
+static const int PatternCacheSize = 32;  // 缓存的表达式个数
+
+QRegularExpression PatternCache::pattern(const QString &str, bool matchCase)
+{
+    static QCache<QString, QRegularExpression> cache(PatternCacheSize);
+
+    QString key = (matchCase ? QLatin1Char('C') : QLatin1Char('I')) + str;
+    QRegularExpression *re = cache.object(key);  // 同时把它移到最近使用的位置
+    if (!re) {
+        QRegularExpression::PatternOptions options = matchCase ? QRegularExpression::NoPatternOption
+                                                               : QRegularExpression::CaseInsensitiveOption;
+        re = new QRegularExpression(str, options);
+        if (re->isValid()) {
+            re->optimize();
+        }
+        cache.insert(key, re);
+    }
+    return *re;
+}
@@ -0,0 +1,16 @@
+#ifndef PATTERNCACHE_H
+#define PATTERNCACHE_H
+
+#include <QRegularExpression>
+#include <QString>
+
+// 编译过的正则表达式：按（表达式，是否区分大小写）缓存最近用过的 PatternCacheSize 个，
+// 取出时已经过 optimize()（JIT 编译）。查找、替换和全部查找共用（只在界面线程使用，
+// 取出的 QRegularExpression 是隐式共享的副本，可以交给工作线程）
+class PatternCache
+{
+public:
+    static QRegularExpression pattern(const QString &str, bool matchCase); //无效的表达式也会返回，由调用者检查 isValid()
+};
+
+#endif // PATTERNCACHE_H
@@ -0,0 +1,489 @@
+#include <QIODevice>
+#include <QTextCodec>
+#include <QStringList>
+
+#include "piecetable.h"
+#include "literalmatcher.h"
+
+static const int WindowChars = 1024 * 1024;  // 查找时每次取出的字符数
+static const int SliceChars = 256 * 1024;    // 编码写出时每段的字符数
+
+PieceTable::PieceTable()
+    : codec(FileEncoding().codec()), newline("\n"), headerSize(0), total(0)
+{
+}
+
+// 设置原始文件，清空现有内容，之后通过 appendOriginal() 按载入顺序加入片段
+void PieceTable::setOriginal(const QSharedPointer<MappedFile> &file, const FileEncoding &encoding)
+{
+    original = file;
+    codec = encoding.codec();
+    headerSize = encoding.bomLength();  // 片段从字节序标记之后开始
+    added.clear();
+    pieces.clear();
+    total = 0;
+    newline = "\n";
+
+    if (!original) {
+        return;
+    }
+
+    // 按第一个换行决定新插入的换行写成什么
+    qint64 size = qMin<qint64>(original->size() - headerSize, 64 * 1024);
+    QString head = codec->toUnicode(original->data() + headerSize, int(qMax<qint64>(0, size)));
+    int lf = head.indexOf(QLatin1Char('\n'));
+    if (lf > 0 && head.at(lf - 1) == QLatin1Char('\r')) {
+        newline = "\r\n";
+    }
+}
+
+// 追加原始文件中的一段，length 是这段内容在文档中的字符数
+void PieceTable::appendOriginal(qint64 start, qint64 bytes, int length)
+{
+    if (start < headerSize) {
+        bytes -= headerSize - start;
+        start = headerSize;
+    }
+    if (bytes <= 0 && length <= 0) {
+        return;
+    }
+
+    Piece piece;
+    piece.original = true;
+    piece.start = start;
+    piece.bytes = bytes;
+    piece.length = length;
+    pieces.append(piece);
+    total += length;
+}
+
+void PieceTable::insert(int pos, const QString &text)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+
+    int index = splitAt(pos);
+
+    // 连续输入时直接延长上一个片段，片段数不会随按键增长
+    if (index > 0) {
+        Piece &previous = pieces[index - 1];
+        if (!previous.original && previous.start + previous.length == added.size()) {
+            previous.length += text.size();
+            added += text;
+            total += text.size();
+            return;
+        }
+    }
+
+    Piece piece;
+    piece.original = false;
+    piece.start = added.size();
+    piece.bytes = 0;
+    piece.length = text.size();
+    pieces.insert(index, piece);
+    added += text;
+    total += text.size();
+}
+
+void PieceTable::remove(int pos, int length)
+{
+    length = qMin(length, total - pos);
+    if (pos < 0 || length <= 0) {
+        return;
+    }
+
+    int first = splitAt(pos);
+    int last = splitAt(pos + length);
+    pieces.remove(first, last - first);
+    total -= length;
+}
+
+// 片段全部改为引用追加缓冲，原始文件的映射随之释放
+void PieceTable::detach()
+{
+    for (int i = 0; i < pieces.size(); ++i) {
+        if (pieces.at(i).original) {
+            materialize(i);
+        }
+    }
+    original.clear();
+}
+
+// 保存成功且文档未再修改时调用：layout 记录了各片段在新文件中的位置，
+// 之后所有内容都引用新文件，追加缓冲可以释放
+void PieceTable::rebase(const PieceTable &layout, const QSharedPointer<MappedFile> &file)
+{
+    qint64 end = layout.headerSize;
+    if (!layout.pieces.isEmpty()) {
+        end = layout.pieces.last().start + layout.pieces.last().bytes;
+    }
+    if (layout.total != total || !file || file->size() != end) {
+        return; // 文件已经被别人改动过，保留原来的片段
+    }
+
+    original = file;
+    codec = layout.codec;
+    headerSize = layout.headerSize;
+    pieces = layout.pieces;
+    added.clear();
+}
+
+// 原始文件在末尾追加了内容（跟踪日志时）：换用覆盖新长度的映射，已有片段的字节偏移不变。
+// reset() 之后已有片段都在追加缓冲中，新追加的片段引用新的映射
+void PieceTable::remap(const QSharedPointer<MappedFile> &file)
+{
+    if (file && (!original || file->size() >= original->size())) {
+        original = file;
+    }
+}
+
+// 原始文件在打开后被改写或截断时，映射中已不是文档载入时的内容，不能再当作未修改的文本读取：
+// 改为只引用追加缓冲中的 text（由文档取得），编码和换行符保持不变
+void PieceTable::reset(const QString &text)
+{
+    original.clear();
+    added = text;
+    pieces.clear();
+    total = 0;
+
+    if (!text.isEmpty()) {
+        Piece piece;
+        piece.original = false;
+        piece.start = 0;
+        piece.bytes = 0;
+        piece.length = text.size();
+        pieces.append(piece);
+        total = text.size();
+    }
+}
+
+QString PieceTable::originalFileName() const
+{
+    return original ? original->fileName() : QString();
+}
+
+QString PieceTable::text(int pos, int length) const
+{
+    pos = qBound(0, pos, total);
+    length = qBound(0, length, total - pos);
+
+    QString result;
+    result.reserve(length);
+
+    int start = 0;
+    for (int i = 0; i < pieces.size() && length > 0; ++i) {
+        const Piece &piece = pieces.at(i);
+        int end = start + piece.length;
+        if (end > pos) {
+            int from = pos - start;
+            int n = qMin(piece.length - from, length);
+            result += pieceText(piece, from, n);
+            pos += n;
+            length -= n;
+        }
+        start = end;
+    }
+    return result;
+}
+
+// 查找字符串：向前时返回 from 之后（含）的第一个匹配，向后时返回起点不超过 from 的最后一个匹配
+// 按窗口取出文本，相邻窗口重叠 str.size() - 1 个字符，跨窗口的匹配不会漏掉
+int PieceTable::find(const QString &str, int from, bool backward, Qt::CaseSensitivity cs) const
+{
+    LiteralMatcher matcher(str, cs);
+    int overlap = qMax(0, str.size() - 1);
+
+    if (!backward) {
+        for (int pos = qMax(0, from); pos < total; pos += WindowChars) {
+            QString window = text(pos, WindowChars + overlap);
+            int i = matcher.indexIn(window.constData(), window.size(), 0);
+            if (i != -1) {
+                return pos + i;
+            }
+        }
+        return -1;
+    }
+
+    for (int end = qMin(from, total) + 1; end > 0; end -= WindowChars) {
+        int start = qMax(0, end - WindowChars);
+        QString window = text(start, end - start + overlap);
+        int i = matcher.lastIndexIn(window.constData(), window.size(), end - start - 1);
+        if (i != -1) {
+            return start + i;
+        }
+    }
+    return -1;
+}
+
+// 逐行查找正则表达式（与 QTextDocument::find 相同，匹配不跨行），
+// 向前时返回 from 之后（含）的第一个匹配，向后时返回起点不超过 from 的最后一个匹配
+int PieceTable::find(const QRegularExpression &re, int from, bool backward, int *matchedLength) const
+{
+    const QString lf(QLatin1Char('\n'));
+
+    if (!backward) {
+        int start = find(lf, from - 1, true, Qt::CaseSensitive) + 1;  // 所在行的行首
+        while (start <= total) {
+            int end = find(lf, qMin(total, start + WindowChars), false, Qt::CaseSensitive);
+            if (end == -1) {
+                end = total;
+            }
+
+            int lineStart = start;
+            foreach (const QString &line, text(start, end - start).split(QLatin1Char('\n'))) {
+                int offset = from - lineStart;
+                if (offset <= line.size()) {
+                    QRegularExpressionMatch match = re.match(line, qMax(0, offset));
+                    if (match.hasMatch()) {
+                        *matchedLength = match.capturedLength();
+                        return lineStart + match.capturedStart();
+                    }
+                }
+                lineStart += line.size() + 1;
+            }
+
+            if (end >= total) {
+                break;
+            }
+            start = end + 1;
+        }
+        return -1;
+    }
+
+    if (from < 0) {
+        return -1;
+    }
+    int end = find(lf, from, false, Qt::CaseSensitive);   // 所在行的行尾
+    if (end == -1) {
+        end = total;
+    }
+    forever {
+        int start = find(lf, qMax(0, end - WindowChars) - 1, true, Qt::CaseSensitive) + 1;
+
+        // 窗口内靠后的匹配优先
+        int found = -1;
+        int lineStart = start;
+        foreach (const QString &line, text(start, end - start).split(QLatin1Char('\n'))) {
+            int offset = from - lineStart;
+            if (offset >= 0) {
+                // 起点不超过 offset 的最后一个匹配：从行首起逐个向后找
+                int last = qMin(offset, line.size());
+                for (int pos = 0; pos <= last; ) {
+                    QRegularExpressionMatch match = re.match(line, pos);
+                    if (!match.hasMatch() || match.capturedStart() > last) {
+                        break;
+                    }
+                    found = lineStart + match.capturedStart();
+                    *matchedLength = match.capturedLength();
+                    pos = match.capturedStart() + 1;
+                }
+            }
+            lineStart += line.size() + 1;
+        }
+
+        if (found != -1) {
+            return found;
+        }
+        if (start == 0) {
+            return -1;
+        }
+        end = start - 1;
+    }
+}
+
+// 写出一个片段：编码相同的原始片段直接写出映射中的字节，其余内容分段编码，
+// 新插入的换行按原始文件的换行符写出
+bool PieceTable::writePiece(int index, QIODevice *device, QTextCodec *textCodec,
+                            QTextEncoder *encoder, PieceTable *layout) const
+{
+    const Piece &piece = pieces.at(index);
+
+    if (piece.original && textCodec == codec) {
+        if (device->write(original->data() + piece.start, piece.bytes) != piece.bytes) {
+            return false;
+        }
+        layout->appendOriginal(device->pos() - piece.bytes, piece.bytes, piece.length);
+        return true;
+    }
+
+    for (int from = 0; from < piece.length; ) {
+        int n = qMin(SliceChars, piece.length - from);
+        QString slice = pieceText(piece, from, n);
+        if (from + n < piece.length && slice.at(n - 1).isHighSurrogate()) {
+            slice += pieceText(piece, from + n, 1);   // 不要把代理对拆到两段里
+            ++n;
+        }
+        if (newline != "\n") {
+            slice.replace(QLatin1Char('\n'), QString::fromLatin1(newline));
+        }
+
+        QByteArray data = encoder->fromUnicode(slice);
+        if (device->write(data) != data.size()) {
+            return false;
+        }
+        layout->appendOriginal(device->pos() - data.size(), data.size(), n);
+        from += n;
+    }
+    return true;
+}
+
+int PieceTable::splitAt(int pos)
+{
+    int start = 0;
+    for (int i = 0; i < pieces.size(); ++i) {
+        if (start == pos) {
+            return i;
+        }
+
+        int end = start + pieces.at(i).length;
+        if (pos < end) {
+            int k = pos - start;
+            Piece left = pieces.at(i);
+            Piece right = left;
+
+            if (left.original) {
+                qint64 bytes = advance(original->data() + left.start, left.bytes, k);
+                if (bytes < 0) {
+                    // 无法逐字节对应（非 UTF-8 或含有非法序列），改为在追加缓冲中切开
+                    materialize(i);
+                    return splitAt(pos);
+                }
+                left.bytes = bytes;
+                right.start += bytes;
+                right.bytes -= bytes;
+            } else {
+                right.start += k;
+            }
+            left.length = k;
+            right.length -= k;
+
+            pieces[i] = left;
+            pieces.insert(i + 1, right);
+            return i + 1;
+        }
+        start = end;
+    }
+    return pieces.size();
+}
+
+void PieceTable::materialize(int index)
+{
+    Piece &piece = pieces[index];
+    QString text = decode(original->data() + piece.start, piece.bytes);
+
+    piece.original = false;
+    piece.start = added.size();
+    piece.bytes = 0;
+    added += text;
+}
+
+// 从 data 开始跨过 chars 个字符，返回跨过的字节数；遇到无法与解码结果逐字符对应的内容
+// （UTF-16 等编码、非法序列、拆开代理对）时返回 -1
+qint64 PieceTable::advance(const char *data, qint64 bytes, int chars) const
+{
+    int mib = codec->mibEnum();
+    if (mib != 106 && mib != 4 && mib != 114) {     // UTF-8、Latin-1、GB18030
+        return -1;
+    }
+
+    const uchar *begin = reinterpret_cast<const uchar *>(data);
+    const uchar *end = begin + bytes;
+    const uchar *p = begin;
+
+    while (chars > 0) {
+        if (p >= end) {
+            return -1;
+        }
+
+        uchar c = *p;
+        int n = 1;
+        int units = 1;
+        if (c < 0x80 || mib == 4) {
+            if (c == '\r' && p + 1 < end && p[1] == '\n') {
+                n = 2;  // \r\n 在文档中是一个换行
+            }
+        } else if (mib == 114) {
+            if (c == 0x80 || c == 0xFF || end - p < 2) {
+                return -1;
+            }
+            if (p[1] >= 0x30 && p[1] <= 0x39) {
+                if (end - p < 4 || p[2] < 0x81 || p[2] > 0xFE || p[3] < 0x30 || p[3] > 0x39) {
+                    return -1;
+                }
+                // 四字节序列按顺序编号：81 30 81 30 起是 BMP 中的字符，90 30 81 30 起是 BMP 之外的字符，
+                // 其余（85～8F 开头、E3 32 9A 35 之后等）未分配，解码结果的长度不确定
+                int linear = (((c - 0x81) * 10 + (p[1] - 0x30)) * 126 + (p[2] - 0x81)) * 10 + (p[3] - 0x30);
+                int supplementary = ((0x90 - 0x81) * 10) * 126 * 10;
+                if (linear <= 39419) {
+                    units = 1;  // 到 84 31 A4 39（U+FFFF）为止
+                } else if (linear >= supplementary && linear <= supplementary + 0xFFFFF) {
+                    units = 2;
+                } else {
+                    return -1;
+                }
+                n = 4;
+            } else if ((p[1] >= 0x40 && p[1] <= 0x7E) || (p[1] >= 0x80 && p[1] <= 0xFE)) {
+                n = 2;
+            } else {
+                return -1;
+            }
+        } else if (c >= 0xC2 && c < 0xE0) {
+            n = 2;
+        } else if (c >= 0xE0 && c < 0xF0) {
+            n = 3;
+        } else if (c >= 0xF0 && c < 0xF5) {
+            n = 4;
+            units = 2;
+        } else {
+            return -1;
+        }
+
+        if (end - p < n || units > chars) {
+            return -1;
+        }
+        if (mib == 106 && c >= 0x80) {
+            for (int i = 1; i < n; ++i) {
+                if ((p[i] & 0xC0) != 0x80) {
+                    return -1;
+                }
+            }
+            if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] >= 0xA0)
+                    || (c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] >= 0x90)) {
+                return -1;  // 超长编码、代理区和超出范围的码点
+            }
+        }
+
+        p += n;
+        chars -= units;
+    }
+    return p - begin;
+}
+
+QString PieceTable::pieceText(const Piece &piece, int from, int length) const
+{
+    if (!piece.original) {
+        return added.mid(int(piece.start) + from, length);
+    }
+
+    const char *data = original->data() + piece.start;
+    qint64 skip = advance(data, piece.bytes, from);
+    if (skip >= 0) {
+        qint64 bytes = advance(data + skip, piece.bytes - skip, length);
+        if (bytes >= 0) {
+            return decode(data + skip, bytes);
+        }
+    }
+    return decode(data, piece.bytes).mid(from, length);
+}
+
+// 解码原始文件中的一段，换行统一为 \n
+QString PieceTable::decode(const char *data, qint64 bytes) const
+{
+    QString text = codec->toUnicode(data, int(bytes));
+    if (text.contains(QLatin1Char('\r'))) {
+        text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+        text.replace(QLatin1Char('\r'), QLatin1Char('\n'));
+    }
+    return text;
+}
@@ -0,0 +1,77 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QRegularExpression>
+#include <QSharedPointer>
+
+#include "mappedfile.h"
+#include "encoding.h"
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+QT_FORWARD_DECLARE_CLASS(QTextCodec)
+QT_FORWARD_DECLARE_CLASS(QTextEncoder)
+QT_END_NAMESPACE
+
+// 片段表：文本由只读的原始文件（内存映射）和只追加的缓冲区中的片段依次拼接而成，
+// 未修改的部分不占内存，片段表自身的内存只随修改量增长。
+// 编辑器中显示和编辑的仍是 QTextDocument，文档占用的内存仍与文件大小成正比；
+// 片段表只是与它同步的副本，用来给保存和查找提供快照，不是文档内容的存储。
+// 原始文件被其他程序改动后（见 isStale()），映射中的内容不再可信，由使用者用 reset() 重建。
+// 位置与 QTextDocument 一致：换行（包括 \r\n）计为一个字符，取出的文本中换行为 \n。
+// 复制一份（只复制片段列表，缓冲区隐式共享）即得到可以交给工作线程的快照
+class PieceTable
+{
+public:
+    PieceTable();
+
+    void setOriginal(const QSharedPointer<MappedFile> &file, const FileEncoding &encoding); //设置原始文件并清空内容
+    void appendOriginal(qint64 start, qint64 bytes, int length); //追加原始文件中的一段（载入时）
+    void insert(int pos, const QString &text);  //插入文本（换行为 \n）
+    void remove(int pos, int length);   //删除文本
+    void detach();  //把原始文件中的片段全部复制到追加缓冲，不再引用原始文件
+    void rebase(const PieceTable &layout, const QSharedPointer<MappedFile> &file); //保存后改为引用新文件
+    void remap(const QSharedPointer<MappedFile> &file); //原始文件增长后换用新的映射
+    void reset(const QString &text); //原始文件被改动后，用文档的全部内容重建，不再引用原始文件
+    bool isStale() const { return original && original->isChanged(); } //原始文件是否已被其他程序改动
+
+    int length() const { return total; }
+    QString text(int pos, int length) const;    //取出一段文本
+    QString originalFileName() const;
+    QTextCodec *textCodec() const { return codec; }
+
+    int find(const QString &str, int from, bool backward, Qt::CaseSensitivity cs) const; //查找字符串
+    int find(const QRegularExpression &re, int from, bool backward, int *matchedLength) const; //逐行查找正则表达式
+
+    int pieceCount() const { return pieces.size(); }
+    int pieceLength(int index) const { return pieces.at(index).length; }
+    bool writePiece(int index, QIODevice *device, QTextCodec *codec, QTextEncoder *encoder,
+                    PieceTable *layout) const;  //写出一个片段，并在 layout 中记录它在新文件中的位置
+
+private:
+    struct Piece {
+        bool original;  //来自原始文件还是追加缓冲
+        qint64 start;   //原始文件中的字节偏移，或追加缓冲中的字符偏移
+        qint64 bytes;   //原始文件中的字节数
+        int length;     //字符数
+    };
+
+    int splitAt(int pos);   //在 pos 处切开片段，返回从 pos 开始的片段下标
+    void materialize(int index);    //把一个原始片段复制到追加缓冲
+    qint64 advance(const char *data, qint64 bytes, int chars) const; //跨过 chars 个字符的字节数
+    QString pieceText(const Piece &piece, int from, int length) const;
+    QString decode(const char *data, qint64 bytes) const;
+
+    QSharedPointer<MappedFile> original;
+    QTextCodec *codec;  //原始文件的编码
+    QByteArray newline; //原始文件使用的换行符，新插入的换行按它写出
+    qint64 headerSize;  //原始文件开头的字节序标记
+    QString added;      //只追加的缓冲区
+    QVector<Piece> pieces;
+    int total;
+};
+
+#endif // PIECETABLE_H
@@ -1,7 +1,78 @@
+#include <QMessageBox>
+#include <QFileDialog>
+#include <QRegularExpression>
+#include <QTimer>
+
 #include "searchdialog.h"
+#include "notepad.h"
+
+static const int ResultTextLength = 200;   // 结果列表中每行最多显示的字符数
+static const int TypingDelay = 100;        // 停止输入这么久（毫秒）后开始边输入边查找
+
+/**************FindResultsModel******************/
+FindResultsModel::FindResultsModel(QObject *parent)
+    : QAbstractListModel(parent), rows(0)
+{
+}
+
+void FindResultsModel::setEditor(NotePad *editor)
+{
+    if (editor == notePad) {
+        return;
+    }
+
+    beginResetModel();
+    if (notePad) {
+        disconnect(notePad, 0, this, 0);
+    }
+    notePad = editor;
+    rows = notePad ? notePad->findMatches().size() : 0;
+    if (notePad) {
+        connect(notePad, SIGNAL(matchesFound(int)), this, SLOT(matchesFound(int)));
+        connect(notePad, SIGNAL(findAllCleared()), this, SLOT(matchesCleared()));
+        connect(notePad, SIGNAL(destroyed()), this, SLOT(matchesCleared()));
+    }
+    endResetModel();
+}
+
+int FindResultsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows;
+}
+
+// 显示为“行:列  该行的文本”
+QVariant FindResultsModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole || !notePad || index.row() >= notePad->findMatches().size()) {
+        return QVariant();
+    }
+
+    const FindMatch &match = notePad->findMatches().at(index.row());
+    QTextBlock block = notePad->document()->findBlock(match.position);
+    return tr("%1:%2  %3").arg(block.blockNumber() + 1).arg(match.position - block.position() + 1)
+                          .arg(block.text().left(ResultTextLength).simplified());
+}
+
+void FindResultsModel::matchesFound(int total)
+{
+    if (total > rows) {
+        beginInsertRows(QModelIndex(), rows, total - 1);
+        rows = total;
+        endInsertRows();
+    }
+}
+
+void FindResultsModel::matchesCleared()
+{
+    beginResetModel();
+    rows = 0;
+    endResetModel();
+}
+
+/**************SearchDialog******************/
 
 SearchDialog::SearchDialog(Config *config, QWidget *parent) :
-    QWidget(parent), config(config)
+    QWidget(parent), config(config), lastMatchCase(false), lastRegExp(false)
 {
     setupUi(this);
     setWindowIcon(QIcon(tr(":images/notepad.png")));
@@ -16,18 +87,40 @@ SearchDialog::SearchDialog(Config *config, QWidget *parent) :
 
     matchCaseCheck->setChecked(config->matchCase);
     regExpCheck->setChecked(config->regExp);
+    directoryEdit->setText(config->findDirectory);
+    filterEdit->setText(config->findFilters);
+
+    results = new FindResultsModel(this);
+    resultList->setModel(results);
+    resultList->hide();
+    countLabel->hide();
 
     connect(findNextButton, SIGNAL(clicked()), SLOT(search()));
     connect(findPreviousButton, SIGNAL(clicked()), SLOT(search()));
     connect(replaceNextButton, SIGNAL(clicked()), SLOT(replace()));
     connect(replacePreviousButton, SIGNAL(clicked()), SLOT(replace()));
     connect(replaceAllButton, SIGNAL(clicked()), SLOT(replace()));
+    connect(findAllButton, SIGNAL(clicked()), SLOT(findAll()));
+    connect(findInFilesButton, SIGNAL(clicked()), SLOT(findInFiles()));
+    connect(browseButton, SIGNAL(clicked()), SLOT(browseDirectory()));
+
+    typingTimer = new QTimer(this);
+    typingTimer->setSingleShot(true);
+    typingTimer->setInterval(TypingDelay);
+    connect(typingTimer, SIGNAL(timeout()), SLOT(incrementalSearch()));
+    connect(findCombo, SIGNAL(editTextChanged(QString)), SLOT(queryChanged()));
+    connect(matchCaseCheck, SIGNAL(toggled(bool)), SLOT(queryChanged()));
+    connect(regExpCheck, SIGNAL(toggled(bool)), SLOT(queryChanged()));
+    connect(resultList, SIGNAL(activated(QModelIndex)), SLOT(showResult(QModelIndex)));
+    connect(resultList, SIGNAL(clicked(QModelIndex)), SLOT(showResult(QModelIndex)));
 }
 
 SearchDialog::~SearchDialog()
 {
     config->matchCase = matchCaseCheck->isChecked();
     config->regExp = regExpCheck->isChecked();
+    config->findDirectory = directoryEdit->text();
+    config->findFilters = filterEdit->text();
 
     config->findHistory.clear();
 
@@ -72,6 +165,132 @@ void SearchDialog::replace()
     }
 }
 
+// 查找、替换、全部查找只连接到当前的编辑器，先断开上一个编辑器，
+// 否则每个曾经查找过的标签页都会跟着查找，全部替换会改掉这些标签页并各弹出一次结果
+void SearchDialog::setEditor(NotePad *notePad)
+{
+    NotePad *old = results->editor();
+    if (notePad == old) {
+        return;
+    }
+    if (old) {
+        disconnect(this, SIGNAL(search(QString, bool, bool, bool)), old, SLOT(search(QString, bool, bool, bool)));
+        disconnect(this, SIGNAL(findAll(QString, bool, bool)), old, SLOT(findAll(QString, bool, bool)));
+        disconnect(this, SIGNAL(replace(QString, QString, bool, bool, bool)),
+                   old, SLOT(replace(QString, QString, bool, bool, bool)));
+        disconnect(this, SIGNAL(replaceAll(QString, QString, bool, bool)),
+                   old, SLOT(replaceAll(QString, QString, bool, bool)));
+        disconnect(old, SIGNAL(replacedAll(int)), this, SLOT(replacedAll(int)));
+        disconnect(old, SIGNAL(matchesFound(int)), this, SLOT(matchesFound(int)));
+        disconnect(old, SIGNAL(findAllFinished(int)), this, SLOT(findAllFinished(int)));
+        disconnect(old, SIGNAL(findAllCleared()), this, SLOT(findAllCleared()));
+    }
+    results->setEditor(notePad);
+    if (notePad) {
+        connect(this, SIGNAL(search(QString, bool, bool, bool)), notePad, SLOT(search(QString, bool, bool, bool)));
+        connect(this, SIGNAL(findAll(QString, bool, bool)), notePad, SLOT(findAll(QString, bool, bool)));
+        connect(this, SIGNAL(replace(QString, QString, bool, bool, bool)),
+                notePad, SLOT(replace(QString, QString, bool, bool, bool)));
+        connect(this, SIGNAL(replaceAll(QString, QString, bool, bool)),
+                notePad, SLOT(replaceAll(QString, QString, bool, bool)));
+        connect(notePad, SIGNAL(replacedAll(int)), this, SLOT(replacedAll(int)));
+        connect(notePad, SIGNAL(matchesFound(int)), this, SLOT(matchesFound(int)));
+        connect(notePad, SIGNAL(findAllFinished(int)), this, SLOT(findAllFinished(int)));
+        connect(notePad, SIGNAL(findAllCleared()), this, SLOT(findAllCleared()));
+    }
+    countLabel->clear();
+    lastText.clear();
+}
+
+//全部查找：结果在后台陆续加入列表
+void SearchDialog::findAll()
+{
+    update (findCombo);
+
+    if (resultList->isHidden()) {
+        resultList->show();
+        countLabel->show();
+        resize(width(), qMax(height(), 300));
+    }
+    emit findAll(findCombo->currentText(), matchCaseCheck->isChecked(), regExpCheck->isChecked());
+}
+
+// 更新历史记录时编辑框的内容也会“改变”，内容和选项都没变时不重新查找
+void SearchDialog::queryChanged()
+{
+    QString text = findCombo->currentText();
+    bool matchCase = matchCaseCheck->isChecked();
+    bool regExp = regExpCheck->isChecked();
+    if (text == lastText && matchCase == lastMatchCase && regExp == lastRegExp) {
+        return;
+    }
+    lastText = text;
+    lastMatchCase = matchCase;
+    lastRegExp = regExp;
+
+    if (results->editor()) {
+        results->editor()->clearFindAll();
+    }
+    typingTimer->start();
+}
+
+//边输入边查找：不记入查找历史，匹配数显示在 countLabel 中
+void SearchDialog::incrementalSearch()
+{
+    if (!results->editor()) {
+        return;
+    }
+    countLabel->show();
+    results->editor()->incrementalSearch(lastText, lastMatchCase, lastRegExp);
+}
+
+//在文件中查找：结果显示在主窗口的结果面板中，文件名模式以空格、逗号或分号分隔
+void SearchDialog::findInFiles()
+{
+    update (findCombo);
+
+    QStringList nameFilters = filterEdit->text().split(QRegularExpression("[\\s,;]+"), QString::SkipEmptyParts);
+    emit findInFiles(findCombo->currentText(), matchCaseCheck->isChecked(), regExpCheck->isChecked(),
+                     directoryEdit->text().trimmed(), nameFilters);
+}
+
+void SearchDialog::browseDirectory()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, tr("Find in Files"), directoryEdit->text());
+    if (!directory.isEmpty()) {
+        directoryEdit->setText(QDir::toNativeSeparators(directory));
+    }
+}
+
+void SearchDialog::matchesFound(int total)
+{
+    countLabel->setText(tr("Searching... %n match(es) so far", 0, total));
+}
+
+void SearchDialog::findAllFinished(int total)
+{
+    countLabel->setText(tr("%n match(es)", 0, total));
+}
+
+void SearchDialog::findAllCleared()
+{
+    countLabel->clear();
+}
+
+void SearchDialog::showResult(const QModelIndex &index)
+{
+    if (results->editor() && index.isValid()) {
+        results->editor()->showMatch(index.row());
+    }
+}
+
+//全部替换的结果
+void SearchDialog::replacedAll(int count)
+{
+    QMessageBox::information(this, tr("Replace All"),
+                             tr("%n occurrence(s) replaced.", 0, count));
+}
+
 //更新查找/替换历史
 void SearchDialog::update(QComboBox *combo)
 {
@@ -2,9 +2,35 @@
 #define SEARCHDIALOG_H
 
 #include <QWidget>
+#include <QAbstractListModel>
+#include <QPointer>
 #include "ui_searchdialog.h"
 #include "config.h"
 
+class NotePad;
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+// 全部查找的结果列表：每一项的行号和该行的文本在显示时才从文档取出，结果很多时也不占多少内存
+class FindResultsModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit FindResultsModel(QObject *parent = 0);
+    void setEditor(NotePad *notePad); //显示这个编辑器的全部查找结果
+    NotePad *editor() const { return notePad; }
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void matchesFound(int total); //加入新找到的匹配
+    void matchesCleared(); //结果已清除或编辑器已关闭
+
+private:
+    QPointer<NotePad> notePad;
+    int rows; //已加入列表的匹配数
+};
+
 class SearchDialog: public QWidget, private Ui::SearchDialog
 {
     Q_OBJECT
@@ -12,20 +38,40 @@ class SearchDialog: public QWidget, private Ui::SearchDialog
 public:
     SearchDialog(Config *, QWidget * = 0);
     ~SearchDialog();
+    void setEditor(NotePad *notePad); //查找、替换、全部查找在这个编辑器中进行（只连接这一个编辑器）
+
+public slots:
+    void replacedAll(int count); //显示全部替换的个数
 
 signals:
     void search(QString, bool, bool, bool); // 查找
     void replace(QString, QString, bool, bool, bool); //替换
     void replaceAll(QString, QString, bool, bool); //全部替换
+    void findAll(QString, bool, bool); //全部查找
+    void findInFiles(QString, bool, bool, QString, QStringList); //在文件中查找（目录为空时查找打开的标签页）
 
 private slots:
     void search(); //查找
     void replace(); //替换
+    void findAll(); //全部查找
+    void findInFiles(); //在文件中查找
+    void browseDirectory(); //选择查找的目录
+    void queryChanged(); //查找内容或选项改变：马上停止上一次边输入边查找，停止输入后再重新开始
+    void incrementalSearch(); //边输入边查找
+    void matchesFound(int total); //全部查找的进度
+    void findAllFinished(int total); //全部查找结束
+    void findAllCleared(); //全部查找的结果已清除
+    void showResult(const QModelIndex &index); //跳到结果列表中选中的匹配
 
 private:
     void update(QComboBox *); //更新查找/替换历史
 
     Config *config;
+    FindResultsModel *results;
+    QTimer *typingTimer; //输入停顿后开始边输入边查找
+    QString lastText; //上一次边输入边查找的内容和选项
+    bool lastMatchCase;
+    bool lastRegExp;
 };
 
 #endif // SEARCHDIALOG_H
@@ -0,0 +1,44 @@
+# Built-in syntax definitions.
+# When qmake runs, every SynatxHight/*.txt file is turned into a sorted
+# keyword table in the generated header syntaxtables.h, so the built-in
+# languages need no parsing at startup. The definition files are added to
+# QMAKE_INTERNAL_INCLUDED_FILES, so editing one re-runs qmake on the next build.
+# Definition files must be named like C identifiers (the name becomes part of
+# the table's symbol name).
+
+SYNTAX_OUT = $$OUT_PWD/generated
+SYNTAX_TABLES =
+SYNTAX_LANGUAGES =
+
+for(def, $$list($$files($$PWD/SynatxHight/*.txt))) {
+    name = $$basename(def)
+    name = $$section(name, ., 0, 0)
+    entries =
+    lines = $$cat($$def, lines)
+    for(line, lines) {
+        # "keyword r g b", separated by spaces or tabs; lines starting with $$ are comments
+        # (\x24 is "$": a literal $$ would be expanded by qmake)
+        contains(line, ^\\s*\\x24\\x24): next()
+        line = $$replace(line, \\s+, " ")
+        fields = $$split(line, " ")
+        !count(fields, 4): next()
+        word = $$member(fields, 0)
+        r = $$member(fields, 1)
+        g = $$member(fields, 2)
+        b = $$member(fields, 3)
+        !contains(r, [0-9]+)|!contains(g, [0-9]+)|!contains(b, [0-9]+): next()
+        # Escape \ and " for the C string literal. The value is unescaped once by
+        # qmake, so each side below is a single backslash to match and two to insert
+        word = $$replace(word, \\\\, \\\\)
+        word = $$replace(word, \", \\\")
+        entries += SYNTAX_KEYWORD(\"$$word\",$$r,$$g,$$b)
+    }
+    SYNTAX_TABLES += SYNTAX_BEGIN($$name) $$sorted(entries) SYNTAX_END($$name)
+    SYNTAX_LANGUAGES += SYNTAX_LANGUAGE($$name)
+    QMAKE_INTERNAL_INCLUDED_FILES += $$def
+}
+
+SYNTAX_TABLES += $$SYNTAX_LANGUAGES
+mkpath($$SYNTAX_OUT)
+write_file($$SYNTAX_OUT/syntaxtables.h, SYNTAX_TABLES)
+INCLUDEPATH += $$SYNTAX_OUT